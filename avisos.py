@@ -0,0 +1,157 @@
+import sys
+import time
+import errno
+import struct
+import threading
+import serial                       # LIBRERIA PARA PUERTO SERIAL
+
+try:
+	import fcntl
+	import termios
+except ImportError:					# Windows: solo el modo por consulta
+	fcntl = None
+
+# -----------------------------------------------------------------------------------
+# Avisos de la placa por el endpoint de interrupcion del CDC (pic18f2550ccs/avisos.h).
+#
+#	python avisos.py /dev/ttyACM0
+#
+# El PIC manda una notificacion SERIAL_STATE solo cuando algo cambia y el
+# driver del sistema la convierte en lineas de modem:
+#	DSR      'datos'   cambia tras bloques nuevos   -> funcion(cambios)
+#	RI       'umbral'  senal sobre ADQ_UMBRAL       -> funcion(True/False)
+#	overrun  'lleno'   anillo de adquisicion casi lleno -> funcion(veces)
+#
+# En Linux el hilo duerme en TIOCMIWAIT hasta que el driver cdc_acm recibe una
+# notificacion, y TIOCGICOUNT cuenta los cambios, asi no se pierden dos cambios
+# seguidos de DSR. En otros sistemas se consultan las lineas cada 'cada'
+# segundos y 'lleno' no se ve (pyserial no da la cuenta de overrun).
+#
+# DCD no se usa: si baja, cdc_acm cuelga el tty de quien lo abrio sin CLOCAL.
+
+AVISOS = ('datos', 'umbral', 'lleno')
+
+class AvisosSerie:
+
+	def __init__(self, puerto, cada=0.02):
+		# puerto: serial.Serial ya abierto
+		self.puerto = puerto
+		self.cada = cada
+		self.llamadas = {nombre: [] for nombre in AVISOS}
+		self.espera = fcntl is not None and hasattr(termios, 'TIOCMIWAIT')
+		self._seguir = False
+		self._hilo = None
+		self._cuentas = self._leer_cuentas()
+		self._dsr, self._umbral = self._lineas()
+
+	def al(self, nombre, funcion):
+		# registra funcion(valor) para el aviso 'nombre'; se llama desde el hilo de avisos
+		self.llamadas[nombre].append(funcion)
+
+	def esperar(self):
+		# bloquea hasta el proximo aviso y devuelve la lista de (nombre, valor)
+		while True:
+			if self.espera:
+				mascara = termios.TIOCM_DSR | termios.TIOCM_RNG
+				try:
+					fcntl.ioctl(self.puerto.fileno(), termios.TIOCMIWAIT, mascara)
+				except OSError as e:
+					if e.errno not in (errno.EINVAL, errno.ENOTTY):
+						raise						# EIO: se desconecto la placa
+					self.espera = False				# el driver no lo soporta: por consulta
+			else:
+				time.sleep(self.cada)
+			avisos = self._cambios()
+			if avisos:
+				return avisos
+
+	def iniciar(self):
+		# atiende los avisos en un hilo propio
+		self._hilo = threading.Thread(target=self.correr, daemon=True)
+		self._hilo.start()
+
+	def detener(self):
+		# correr() termina en el proximo aviso o al cerrarse el puerto
+		self._seguir = False
+
+	def correr(self):
+		# llama a las funciones registradas con cada aviso, hasta detener() o
+		# hasta que se desconecte la placa
+		self._seguir = True
+		while self._seguir:
+			try:
+				avisos = self.esperar()
+			except (OSError, serial.SerialException):		# se desconecto la placa
+				return
+			if not self._seguir:
+				return
+			for nombre, valor in avisos:
+				for funcion in self.llamadas[nombre]:
+					funcion(valor)
+
+	def _lineas(self):
+		return self.puerto.dsr, self.puerto.ri
+
+	def _leer_cuentas(self):
+		# (dsr, overrun) de struct serial_icounter_struct, o None sin TIOCGICOUNT
+		if fcntl is None or not hasattr(termios, 'TIOCGICOUNT'):
+			return None
+		try:
+			datos = fcntl.ioctl(self.puerto.fileno(), termios.TIOCGICOUNT, bytes(80))
+		except OSError:
+			return None
+		cts, dsr, rng, dcd, rx, tx, frame, overrun = struct.unpack_from('8i', datos)
+		return dsr, overrun
+
+	def _cambios(self):
+		avisos = []
+		cuentas = self._leer_cuentas()
+		dsr, ri = self._lineas()
+		if cuentas is not None and self._cuentas is not None:
+			dsr_n, over_n = (a - b for a, b in zip(cuentas, self._cuentas))
+		else:								# por consulta: solo se ven los niveles
+			dsr_n = int(dsr != self._dsr)
+			over_n = 0
+		self._cuentas = cuentas
+		self._dsr = dsr
+
+		# RI es un nivel: cdc_acm cuenta rng en cada notificacion con RI en 1,
+		# no en cada cambio, asi que se compara con el ultimo visto
+		if dsr_n:
+			avisos.append(('datos', dsr_n))
+		if ri != self._umbral:
+			self._umbral = ri
+			avisos.append(('umbral', ri))
+		if over_n:
+			avisos.append(('lleno', over_n))
+		return avisos
+
+# -----------------------------------------------------------------------------------
+
+def main():
+	if len(sys.argv) < 2:
+		print('uso: python avisos.py PUERTO')
+		return 1
+
+	puerto = serial.Serial(sys.argv[1], 115200, timeout=0)
+	avisos = AvisosSerie(puerto)
+	recibidos = [0]
+
+	def datos(n):
+		# los bytes pueden llegar un poco despues del aviso: lo que falte sale en el proximo
+		recibidos[0] += len(puerto.read(puerto.in_waiting))
+		print('datos: %d cambios, %d bytes leidos' % (n, recibidos[0]))
+
+	avisos.al('datos', datos)
+	avisos.al('umbral', lambda arriba: print('umbral: %s' % ('arriba' if arriba else 'abajo')))
+	avisos.al('lleno', lambda n: print('buffer casi lleno (%d)' % n))
+	print('esperando avisos (%s)' % ('TIOCMIWAIT' if avisos.espera else 'consulta'))
+	try:
+		avisos.correr()
+	except KeyboardInterrupt:
+		pass
+	puerto.close()
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
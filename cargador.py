@@ -0,0 +1,178 @@
+import sys
+import time
+import struct
+import collections
+import serial                       # LIBRERIA PARA PUERTO SERIAL
+import serial.tools.list_ports
+
+# -----------------------------------------------------------------------------------
+# Actualizacion de firmware por el mismo puerto USB CDC (ver pic18f2550ccs/cargador.h)
+#
+#	python cargador.py PUERTO archivo.hex [ventana]
+#
+# Lo primero que se manda es siempre 'B': la aplicacion (main.c o
+# pic18f_ejemplo.c) se reinicia en el cargador y el cargador lo ignora. No se
+# consulta antes con 'Q', que para pic18f_ejemplo.c abre un pedido numerado.
+# Despues se espera a que vuelva a aparecer el puerto con el cargador. Luego se recorre toda la zona
+# de la aplicacion fila por fila (las filas que no estan en el .hex van en
+# 0xFF), con hasta 'ventana' filas enviadas sin confirmar: mientras el PIC
+# graba una fila ya tiene la siguiente en camino. Las filas que ya estan
+# iguales en la flash no se graban.
+
+VENTANA = 4				# filas en vuelo por defecto
+
+def crc16(datos, crc=0xFFFF):
+	# CRC16-CCITT (0x1021), igual que en cargador.c
+	for b in datos:
+		crc ^= b << 8
+		for i in range(8):
+			if crc & 0x8000:
+				crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+			else:
+				crc = (crc << 1) & 0xFFFF
+	return crc
+
+# -----------------------------------------------------------------------------------
+# lectura del Intel HEX
+
+def leer_hex(nombre):
+	memoria = {}
+	base = 0
+	with open(nombre) as f:
+		for n, linea in enumerate(f, 1):
+			linea = linea.strip()
+			if not linea:
+				continue
+			if linea[0] != ':':
+				raise ValueError('linea %d: no es Intel HEX' % n)
+			reg = bytes.fromhex(linea[1:])
+			if sum(reg) & 0xFF:
+				raise ValueError('linea %d: checksum incorrecto' % n)
+			largo, dir, tipo = reg[0], (reg[1] << 8) | reg[2], reg[3]
+			datos = reg[4:4 + largo]
+			if tipo == 0:				# datos
+				for i, b in enumerate(datos):
+					memoria[base + dir + i] = b
+			elif tipo == 1:				# fin de archivo
+				break
+			elif tipo == 2:				# segmento extendido
+				base = ((datos[0] << 8) | datos[1]) << 4
+			elif tipo == 4:				# direccion lineal extendida
+				base = ((datos[0] << 8) | datos[1]) << 16
+	return memoria
+
+def armar_filas(memoria, inicio, fin, fila):
+	# imagen completa de la zona de la aplicacion, fila por fila
+	fuera = [d for d in memoria if d < inicio and d < 0x300000]
+	if fuera:
+		raise ValueError('el .hex escribe en la zona del cargador (0x%04X); '
+						 'compile la aplicacion con cargador.h' % min(fuera))
+	filas = []
+	for dir in range(inicio, fin + 1, fila):
+		filas.append((dir, bytes(memoria.get(dir + i, 0xFF) for i in range(fila))))
+	return filas
+
+# -----------------------------------------------------------------------------------
+# comunicacion con el cargador
+
+def leer_exacto(puerto, n):
+	datos = puerto.read(n)
+	if len(datos) != n:
+		raise IOError('el cargador no responde')
+	return datos
+
+def consultar(puerto):
+	puerto.reset_input_buffer()
+	puerto.write(b'Q')
+	r = puerto.read(10)
+	if len(r) != 10 or r[0:1] != b'Q':
+		return None
+	version = r[1]
+	inicio = int.from_bytes(r[2:5], 'little')
+	fin = int.from_bytes(r[5:8], 'little')
+	return version, inicio, fin, r[8]
+
+def entrar_cargador(nombre):
+	# la aplicacion se reinicia en el cargador y el puerto desaparece un momento;
+	# si ya estaba en el cargador, 'B' no hace nada y el puerto sigue ahi
+	with serial.Serial(nombre, 115200, timeout=0.3) as puerto:
+		puerto.write(b'B')
+	time.sleep(0.5)
+	limite = time.monotonic() + 10
+	while time.monotonic() < limite:
+		if nombre in [p.device for p in serial.tools.list_ports.comports()]:
+			try:
+				with serial.Serial(nombre, 115200, timeout=0.3) as puerto:
+					info = consultar(puerto)
+					if info:
+						return info
+			except serial.SerialException:
+				pass
+		time.sleep(0.2)
+	raise IOError('la placa no entro al cargador')
+
+def grabar(puerto, filas, ventana=VENTANA):
+	pendientes = collections.deque()
+	grabadas = iguales = 0
+	i = 0
+
+	while i < len(filas) or pendientes:
+		# mantiene la ventana llena antes de esperar confirmaciones
+		while i < len(filas) and len(pendientes) < ventana:
+			dir, datos = filas[i]
+			puerto.write(b'W' + dir.to_bytes(3, 'little') + datos +
+						 struct.pack('<H', crc16(datos)))
+			pendientes.append(filas[i])
+			i += 1
+
+		dir, datos = pendientes.popleft()
+		r = leer_exacto(puerto, 7)
+		dir_r = int.from_bytes(r[1:4], 'little')
+		est = r[4:5]
+		crc_r = struct.unpack('<H', r[5:7])[0]
+		if r[0:1] != b'K' or dir_r != dir:
+			raise IOError('respuesta fuera de orden en 0x%04X' % dir)
+		if est == b'E' or crc_r != crc16(datos):
+			raise IOError('fallo la verificacion en 0x%04X (crc 0x%04X)' % (dir, crc_r))
+		if est == b'W':
+			grabadas += 1
+		else:
+			iguales += 1
+
+	return grabadas, iguales
+
+def crc_region(puerto, inicio, largo):
+	puerto.write(b'C' + inicio.to_bytes(3, 'little') + struct.pack('<H', largo))
+	r = leer_exacto(puerto, 3)
+	return struct.unpack('<H', r[1:3])[0]
+
+# -----------------------------------------------------------------------------------
+
+def main():
+	if len(sys.argv) < 3:
+		print('uso: python cargador.py PUERTO archivo.hex [ventana]')
+		return 1
+	nombre, archivo = sys.argv[1], sys.argv[2]
+	ventana = int(sys.argv[3]) if len(sys.argv) > 3 else VENTANA
+
+	t0 = time.monotonic()
+	version, inicio, fin, fila = entrar_cargador(nombre)
+	filas = armar_filas(leer_hex(archivo), inicio, fin, fila)
+	imagen = b''.join(d for _, d in filas)
+	print('cargador v%d, aplicacion 0x%04X-0x%04X, %d filas' % (version, inicio, fin, len(filas)))
+
+	with serial.Serial(nombre, 115200, timeout=2) as puerto:
+		grabadas, iguales = grabar(puerto, filas, ventana)
+		crc = crc_region(puerto, inicio, len(imagen))
+		print('grabadas %d, iguales %d, crc flash 0x%04X, crc imagen 0x%04X'
+			  % (grabadas, iguales, crc, crc16(imagen)))
+		if crc != crc16(imagen):
+			print('ERROR: la flash no coincide con la imagen')
+			return 2
+		puerto.write(b'G')			# arranca la aplicacion
+
+	print('listo en %.1f s' % (time.monotonic() - t0))
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
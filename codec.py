@@ -0,0 +1,96 @@
+import struct
+
+# -----------------------------------------------------------------------------------
+# Bloques de lecturas de 10 bits codificados por pic18f2550ccs/codec.h.
+#
+# Cada bloque empieza con un byte de modo:
+#	EMPACADO  4 muestras en 5 bytes: los 8 bits bajos de cada una y un byte con
+#	          los 2 altos (muestra 0 en los bits 1..0); el ultimo grupo puede
+#	          traer menos de 4
+#	DELTA     diferencia con la anterior (la primera contra 0) en zigzag, 1 byte
+#	          si cabe en 7 bits, si no 2 (bit 7 en 1 en el primero)
+# El decodificador necesita saber cuantas muestras trae el bloque (ADQ_BLOQUE).
+#
+# Las funciones de codificacion replican las del PIC, para generar datos de
+# prueba y comprobar ida y vuelta.
+
+EMPACADO = 1
+DELTA = 2
+BLOQUE = 8							# ADQ_BLOQUE de pic18f2550ccs/adq.h
+
+def largo_empacado(n):
+	return n + (n + 3) // 4
+
+# -----------------------------------------------------------------------------------
+# decodificacion
+
+def desempacar(datos, inicio, n):
+	# devuelve (valores, posicion siguiente)
+	valores = []
+	g = inicio
+	while len(valores) < n:
+		k = min(4, n - len(valores))		# el ultimo grupo puede ser corto
+		alto = datos[g + k]
+		for j in range(k):
+			valores.append(datos[g + j] | ((alto >> (2 * j)) & 3) << 8)
+		g += k + 1
+	return valores, g
+
+def des_delta(datos, inicio, n):
+	valores = []
+	anterior = 0
+	i = inicio
+	for _ in range(n):
+		z = datos[i]
+		i += 1
+		if z & 0x80:
+			z = (z & 0x7F) | (datos[i] << 7)
+			i += 1
+		anterior += (z >> 1) ^ -(z & 1)
+		valores.append(anterior)
+	return valores, i
+
+def decodificar(datos, inicio, n):
+	# bloque con su byte de modo; devuelve (valores, posicion siguiente)
+	modo = datos[inicio]
+	if modo == EMPACADO:
+		return desempacar(datos, inicio + 1, n)
+	if modo == DELTA:
+		return des_delta(datos, inicio + 1, n)
+	raise ValueError('modo de bloque desconocido: %d' % modo)
+
+def bloque_con_marca(datos, inicio, n):
+	# ticks(4) + bloque, como en los paquetes isocronos y las tramas Z
+	ticks, = struct.unpack_from('<I', datos, inicio)
+	valores, fin = decodificar(datos, inicio + 4, n)
+	return ticks, valores, fin
+
+# -----------------------------------------------------------------------------------
+# codificacion (igual que en el PIC)
+
+def empacar(valores):
+	datos = bytearray()
+	for g in range(0, len(valores), 4):
+		v = valores[g:g + 4]
+		datos += bytes(x & 0xFF for x in v)
+		datos.append(sum(((x >> 8) & 3) << (2 * j) for j, x in enumerate(v)))
+	return bytes(datos)
+
+def delta(valores, maximo=None):
+	# None si no entra en 'maximo' bytes
+	datos = bytearray()
+	anterior = 0
+	for v in valores:
+		d = v - anterior
+		anterior = v
+		z = (d << 1) ^ (d >> 15)
+		datos += bytes([z]) if z < 0x80 else bytes([(z & 0x7F) | 0x80, z >> 7])
+		if maximo is not None and len(datos) > maximo:
+			return None
+	return bytes(datos)
+
+def codificar(valores):
+	datos = delta(valores, largo_empacado(len(valores)))
+	if datos is not None:
+		return bytes([DELTA]) + datos
+	return bytes([EMPACADO]) + empacar(valores)
@@ -0,0 +1,476 @@
+import threading
+import collections
+import struct
+import time
+import serial                       # LIBRERIA PARA PUERTO SERIAL
+import serial.tools.list_ports
+
+from sincronia import RelojDispositivo
+import codec
+from avisos import AvisosSerie
+
+# -----------------------------------------------------------------------------------
+# Separador de las tramas que envia el PIC. Todas terminan en 'F':
+#	I<valor>F		muestra del ADC en voltios
+#	T<ticks>F		marca de tiempo del bloque de muestras que sigue (reloj.h)
+#	R<ticks>F		respuesta a un ping de sincronizacion
+#	L<min>,<max>F	latencia de la ISR de adquisicion, en ticks (S121$)
+#	U<c>,<e>,<l>,<d>F	hitos del arranque en ms (S125$, arranque.h)
+#	A<ss>[R..|L..|U..]F	respuesta al pedido numerado Q<ss><ccc>$, con la respuesta
+#					de S<ccc>$ si la tiene	-> ('A', (ss, letra o None, valor))
+# y las tramas binarias, que no terminan en 'F':
+#	Z<largo><ticks(4)><bloque de codec.h>	-> ('Z', (ticks, [lecturas de 10 bits]))
+#	Y<largo><indice><total><registros>		parte del volcado de traza.h (S124$)
+#											-> ('Y', (indice, total, [(ticks, evento, dato)]))
+
+def _pareja(texto):
+	minimo, maximo = texto.split(',')
+	return int(minimo), int(maximo)
+
+def _hitos(texto):
+	return tuple(int(ms) for ms in texto.split(','))
+
+HITOS = ('conexion', 'enumerado', 'linea', 'dato')	# de pic18f2550ccs/arranque.h
+
+def a_arranque(valor):
+	# hitos de U..F (o de la respuesta a pedir(125)) -> {nombre: segundos desde
+	# el reset, o None si todavia no ocurrio}
+	return {nombre: ms / 1000 if ms else None for nombre, ms in zip(HITOS, valor)}
+
+def _respuesta(texto):
+	secuencia = int(texto[:2], 16)
+	if len(texto) == 2:
+		return secuencia, None, None
+	letra = texto[2]
+	if letra not in 'RLU':
+		raise ValueError(letra)
+	return secuencia, letra, LETRAS[letra](texto[3:])
+
+TRAZA_POR_TRAMA = 8						# de pic18f2550ccs/traza.h
+LARGO_TRAMA = 28						# PEDIDO_RESPUESTA de pic18f_ejemplo.c: la mas larga
+										# es A<ss>U<c>,<e>,<l>,<d>F con hitos de 5 cifras
+
+LETRAS = {'I': float, 'T': int, 'R': int, 'L': _pareja, 'U': _hitos, 'A': _respuesta}
+
+class Tramas:
+
+	def __init__(self):
+		self._letra = None						# trama en curso
+		self._trama = ''
+		self._binaria = None					# bytes de la trama Z o Y en curso
+		self._binaria_letra = None
+		self._faltan = 0
+
+	def reiniciar(self):
+		self._letra = None
+		self._binaria = None
+
+	def alimentar(self, datos):
+		# devuelve la lista de tramas (letra, valor) completadas con estos bytes
+		tramas = []
+		for b in datos:
+			if self._binaria is not None:
+				self._binario(b, tramas)
+				continue
+			c = chr(b)
+			if c in 'ZY':
+				self._letra = None
+				self._binaria = bytearray()
+				self._binaria_letra = c
+				self._faltan = None
+			elif c in LETRAS and (self._letra != 'A' or c == 'A'):
+				self._letra = c					# la respuesta dentro de A no corta la trama
+				self._trama = ''
+			elif self._letra is None:
+				continue
+			elif c == 'F':
+				try:
+					tramas.append((self._letra, LETRAS[self._letra](self._trama)))
+				except ValueError:
+					pass
+				self._letra = None
+			elif len(self._trama) < LARGO_TRAMA:
+				self._trama += c
+			else:
+				self._letra = None				# trama corrupta
+		return tramas
+
+	def _binario(self, b, tramas):
+		if self._faltan is None:				# byte de largo
+			if self._binaria_letra == 'Z':
+				valido = 4 < b <= 5 + 2 * codec.BLOQUE
+			else:
+				valido = 2 <= b <= 2 + 6 * TRAZA_POR_TRAMA and (b - 2) % 6 == 0
+			if not valido:
+				self._binaria = None			# trama corrupta
+			self._faltan = b
+			return
+		self._binaria.append(b)
+		self._faltan -= 1
+		if self._faltan:
+			return
+		if self._binaria_letra == 'Y':
+			registros = [struct.unpack_from('<IBB', self._binaria, i)
+						 for i in range(2, len(self._binaria), 6)]
+			tramas.append(('Y', (self._binaria[0], self._binaria[1], registros)))
+		else:
+			try:
+				ticks, valores, fin = codec.bloque_con_marca(self._binaria, 0, codec.BLOQUE)
+				if fin == len(self._binaria):
+					tramas.append(('Z', (ticks, valores)))
+			except (ValueError, IndexError):
+				pass
+		self._binaria = None
+
+# -----------------------------------------------------------------------------------
+# Enlace serie con el PIC18F2550 atendido desde un hilo de trabajo.
+#
+# La GUI nunca toca el puerto: deja ordenes en una cola y recoge eventos de
+# otra desde root.after(). Ambas colas son collections.deque, cuyo append() y
+# popleft() son atomicos, asi que ningun lado bloquea al otro.
+#
+# Eventos que produce el hilo (tuplas):
+#	('conectado', nombre_puerto)
+#	('desconectado', None)
+#	('error', codigo)				# codigo de la ventana de error de la GUI
+#	('telemetria', valor)			# valor (float) de cada trama I<valor>F
+#	('bloque', (hora, ticks))		# marca de tiempo del bloque que sigue; hora es
+#									# time.monotonic() del PC, None hasta el primer ping
+#	('latencia', (min, max))		# entrada a la ISR de adquisicion desde el disparo (s)
+#	('arranque', {hito: s})		# respuesta a S125$: conexion, enumerado, linea
+#									# (Set_Line_Coding) y dato; None si aun no
+#	('aviso', (nombre, valor))		# con avisos=True: 'datos', 'umbral' o 'lleno' (avisos.py)
+#	('respuesta', (orden, sec, valor))	# respuesta a pedir(); valor None si la orden no
+#									# devuelve nada
+#	('sin_respuesta', (orden, sec))	# pedido perdido, vencido o cortado al desconectar
+#	('traza', registros)			# volcado completo de traza.h: [(ticks, evento, dato)]
+#									# del mas viejo al mas nuevo (ver traza.py)
+#
+# pedir(orden) manda la orden numerada (Q<ss><ccc>$) sin esperar la respuesta
+# de las anteriores: el hilo mantiene hasta 'ventana' pedidos en vuelo, junta
+# en una sola escritura los que entren y asocia cada respuesta por su numero.
+# El PIC contesta en orden, asi que una respuesta da por perdidos los pedidos
+# anteriores que sigan en vuelo. La cola del PIC (PEDIDOS en pic18f_ejemplo.c)
+# admite a lo sumo VENTANA_MAXIMA.
+#
+# Con 'control' (p.ej. '/dev/ttyACM1', el segundo CDC de pic18f_ejemplo.c con
+# USB_CDC_CTL) los pedidos van por ese puerto, atendido por un hilo propio:
+# las respuestas no esperan detras de las muestras del puerto de datos. Los
+# dos hilos comparten la cola de pedidos, protegida por _cerrojo. Si falla el
+# puerto de ordenes se cierra todo el enlace, como cuando falla el de datos.
+#
+# Si se indica 'ping' (p.ej. b'S120$' para pic18f_ejemplo.c), el hilo lo envia
+# cada 'cada_ping' segundos y ajusta self.reloj con las respuestas R<ticks>F.
+#
+# Con avisos=True el hilo no lee el puerto cada 0.05s: cuando una lectura
+# vuelve vacia y no espera respuestas (ping, pedidos o lo mandado con
+# escribir()), duerme hasta un aviso 'datos' o 'lleno', una orden o el
+# proximo ping, y a lo sumo ESPERA_AVISOS para notar una desconexion.
+
+VENTANA_MAXIMA = 7
+ESPERA_AVISOS = 1.0
+
+class EnlaceSerie:
+
+	def __init__(self, baudrate=115200, saludo=b'P', espera_saludo=0.5, ping=None, cada_ping=1.0,
+				 avisos=False, ventana=4, espera_respuesta=1.0, control=None):
+		self.puerto = serial.Serial() 			# define el objeto puerto serial
+		self.puerto.baudrate = baudrate
+		self.puerto.timeout = 0.05				# lecturas cortas: el hilo nunca se queda colgado
+		self.puerto.write_timeout = 1
+
+		self.saludo = saludo					# msj de conexion (None: no se verifica)
+		self.espera_saludo = espera_saludo		# tiempo maximo de respuesta por puerto (s)
+
+		self.eventos = collections.deque()		# hilo -> GUI
+		self.ordenes = collections.deque()		# GUI -> hilo
+		self.conectado = False					# solo lo escribe el hilo
+
+		self.tramas = Tramas()
+		self.reloj = RelojDispositivo()			# solo lo escribe el hilo
+		self.ping = ping
+		self.cada_ping = cada_ping
+		self._ping_enviado = None				# hora del ping sin respuesta
+		self._proximo_ping = 0
+		self._escrito = 0						# hora del ultimo escribir()
+		self.avisos = avisos					# escucha el endpoint de interrupcion (avisos.h)
+		self._avisos = None
+		self.ventana = min(ventana, VENTANA_MAXIMA)	# pedidos numerados en vuelo
+		self.espera_respuesta = espera_respuesta	# despues de esto se dan por perdidos (s)
+		self._cerrojo = threading.Lock()		# _pedidos y _en_vuelo: hilo de trabajo y de control
+		self._pedidos = collections.deque()		# (orden, sec) aun sin enviar
+		self._en_vuelo = collections.OrderedDict()	# sec -> (orden, hora de envio)
+		self._secuencia = 0
+		self.control = control					# puerto de ordenes (None: el de datos)
+		self.puerto_control = serial.Serial()
+		self.puerto_control.timeout = 0.05
+		self.puerto_control.write_timeout = 1
+		self._hilo_control = None
+		self._traza = []						# volcado de traza.h en curso
+		self._despertar = threading.Event()
+		self._hilo = threading.Thread(target=self._trabajar, daemon=True)
+		self._hilo.start()
+
+	# ---------------------------------------------------------------------------
+	# API para la GUI (no bloquea nunca)
+
+	def conectar(self, nombre=None):
+		# nombre=None: prueba todos los puertos disponibles
+		self._ordenar('conectar', nombre)
+
+	def desconectar(self):
+		self._ordenar('desconectar', None)
+
+	def escribir(self, datos):
+		self._ordenar('escribir', datos)
+
+	def pedir(self, orden):
+		# orden numerada (p.ej. 121); devuelve su numero de secuencia, que vuelve
+		# en el evento 'respuesta' o 'sin_respuesta'
+		sec = self._secuencia
+		self._secuencia = (sec + 1) & 0xFF
+		self._ordenar('pedir', (orden, sec))
+		return sec
+
+	def leer_eventos(self):
+		# saca todos los eventos pendientes
+		while self.eventos:
+			yield self.eventos.popleft()
+
+	def _ordenar(self, orden, dato):
+		self.ordenes.append((orden, dato))
+		self._despertar.set()
+
+	# ---------------------------------------------------------------------------
+	# hilo de trabajo: unico dueño del puerto
+
+	def _trabajar(self):
+		datos = b''
+		while True:
+			while self.ordenes:
+				orden, dato = self.ordenes.popleft()
+				if orden == 'conectar':
+					self._abrir(dato)
+				elif orden == 'desconectar':
+					self._cerrar()
+				elif orden == 'escribir' and self.conectado:
+					try:
+						self.puerto.write(dato)
+						self._escrito = time.monotonic()
+					except serial.SerialException:
+						self._cerrar()
+				elif orden == 'pedir':
+					if self.conectado:
+						with self._cerrojo:
+							self._pedidos.append(dato)
+					else:
+						self.eventos.append(('sin_respuesta', dato))
+				elif orden == 'control_caido' and self.conectado:
+					self._cerrar()
+
+			if self.conectado:
+				try:
+					self._sincronizar()
+					if self.control is None:
+						self._despachar(self.puerto)
+					if self._avisos is not None and not datos and not self._esperando():
+						self._despertar.wait(self._dormir())
+						self._despertar.clear()
+					datos = self.puerto.read(max(1, self.puerto.in_waiting))
+				except serial.SerialException:		# se desconecto la placa
+					self._cerrar()
+					continue
+				self._procesar(datos)
+			else:
+				self._despertar.wait()
+				self._despertar.clear()
+
+	def _abrir(self, nombre):
+		if self.conectado:
+			return
+
+		if nombre is None:
+			nombres = [str(p.device) for p in serial.tools.list_ports.comports()]
+		else:
+			nombres = [nombre]
+
+		for n in nombres:					# intenta conectar con cada puerto
+			self.puerto.port = n
+			try:
+				self.puerto.open()
+				if self.saludo is None or self._saludar():
+					self._abrir_control()
+					self.conectado = True
+					self.tramas.reiniciar()
+					self.reloj = RelojDispositivo()		# otra placa, otro reloj
+					self._ping_enviado = None
+					self.eventos.append(('conectado', n))
+					self._escuchar_avisos()
+					self._atender_control()
+					return
+				self.puerto.close()
+			except (serial.SerialException, OSError):
+				self.puerto.close()
+				self.puerto_control.close()
+
+		self.eventos.append(('error', 'errox04'))
+
+	def _saludar(self):
+		# manda el msj de conexion y espera el eco, ignorando telemetria
+		self.puerto.reset_input_buffer()
+		self.puerto.write(self.saludo)
+		limite = time.monotonic() + self.espera_saludo
+		while time.monotonic() < limite:
+			if self.saludo in self.puerto.read(max(1, self.puerto.in_waiting)):
+				return True
+		return False
+
+	def _abrir_control(self):
+		if self.control is None:
+			return
+		self.puerto_control.port = self.control
+		self.puerto_control.open()
+		self.puerto_control.reset_input_buffer()
+
+	def _atender_control(self):
+		if self.control is None:
+			return
+		self._hilo_control = threading.Thread(target=self._trabajar_control, daemon=True)
+		self._hilo_control.start()
+
+	def _trabajar_control(self):
+		# hilo del puerto de ordenes: solo pedidos y respuestas A<ss>F
+		tramas = Tramas()
+		while self.conectado:
+			try:
+				self._despachar(self.puerto_control)
+				datos = self.puerto_control.read(max(1, self.puerto_control.in_waiting))
+			except (serial.SerialException, OSError, TypeError):
+				if self.conectado:				# fallo el puerto, no lo cerro _cerrar()
+					self._ordenar('control_caido', None)
+				return
+			for letra, valor in tramas.alimentar(datos):
+				if letra == 'A':
+					self._respondido(valor[0], valor[2])
+
+	def _escuchar_avisos(self):
+		# otro hilo duerme esperando las notificaciones de la placa
+		if not self.avisos:
+			return
+		self._avisos = AvisosSerie(self.puerto)
+		for nombre in ('datos', 'umbral', 'lleno'):
+			self._avisos.al(nombre, lambda valor, nombre=nombre:
+							self.eventos.append(('aviso', (nombre, valor))))
+		self._avisos.al('datos', lambda valor: self._despertar.set())	# hay algo para leer
+		self._avisos.al('lleno', lambda valor: self._despertar.set())
+		self._avisos.iniciar()
+
+	def _esperando(self):
+		# respuestas por el puerto de datos que no vienen con aviso
+		if self._ping_enviado is not None:
+			return True
+		if time.monotonic() - self._escrito < self.espera_respuesta:
+			return True
+		if self.control is None:
+			with self._cerrojo:
+				return bool(self._en_vuelo or self._pedidos)
+		return False
+
+	def _dormir(self):
+		# hasta el proximo ping; si se desconecta la placa el hilo de avisos
+		# termina sin avisar, asi que nunca mas de ESPERA_AVISOS
+		if self.ping is None:
+			return ESPERA_AVISOS
+		return min(ESPERA_AVISOS, max(0, self._proximo_ping - time.monotonic()))
+
+	def _cerrar(self):
+		if self._avisos is not None:
+			self._avisos.detener()
+			self._avisos = None
+		self.puerto.close()
+		conectado, self.conectado = self.conectado, False
+		self.puerto_control.close()
+		if self._hilo_control is not None:
+			self._hilo_control.join(1)			# deja de tocar los pedidos
+			self._hilo_control = None
+		with self._cerrojo:
+			for sec, (orden, enviado) in self._en_vuelo.items():
+				self.eventos.append(('sin_respuesta', (orden, sec)))
+			for orden, sec in self._pedidos:
+				self.eventos.append(('sin_respuesta', (orden, sec)))
+			self._en_vuelo.clear()
+			self._pedidos.clear()
+		if conectado:
+			self.eventos.append(('desconectado', None))
+
+	def _sincronizar(self):
+		ahora = time.monotonic()
+		if self.ping is None or ahora < self._proximo_ping:
+			return
+		if self._ping_enviado is not None and ahora - self._ping_enviado < 1.0:
+			return								# aun esperando la respuesta
+		self.puerto.write(self.ping)
+		self._ping_enviado = time.monotonic()
+		self._proximo_ping = self._ping_enviado + self.cada_ping
+
+	def _despachar(self, puerto):
+		# vence los pedidos viejos y llena la ventana con los que esperan, en
+		# una sola escritura (un paquete USB lleva varios pedidos)
+		limite = time.monotonic() - self.espera_respuesta
+		datos = b''
+		with self._cerrojo:
+			while self._en_vuelo:
+				sec, (orden, enviado) = next(iter(self._en_vuelo.items()))
+				if enviado > limite:
+					break
+				del self._en_vuelo[sec]
+				self.eventos.append(('sin_respuesta', (orden, sec)))
+
+			ahora = time.monotonic()
+			while self._pedidos and len(self._en_vuelo) < self.ventana:
+				orden, sec = self._pedidos.popleft()
+				self._en_vuelo[sec] = (orden, ahora)
+				datos += b'Q%02x%03d$' % (sec, orden)
+		if datos:
+			puerto.write(datos)			# fuera del cerrojo: puede tardar
+
+	def _respondido(self, sec, valor):
+		with self._cerrojo:
+			if sec not in self._en_vuelo:
+				return							# ya vencido
+			while True:							# en orden: los anteriores se perdieron
+				s, (orden, enviado) = self._en_vuelo.popitem(last=False)
+				if s == sec:
+					self.eventos.append(('respuesta', (orden, sec, valor)))
+					return
+				self.eventos.append(('sin_respuesta', (orden, s)))
+
+	def _procesar(self, datos):
+		recibido = time.monotonic()
+		for letra, valor in self.tramas.alimentar(datos):
+			if letra == 'I':
+				self.eventos.append(('telemetria', valor))
+			elif letra == 'T':
+				self.eventos.append(('bloque', (self.reloj.a_hora(valor), valor)))
+			elif letra == 'Z':					# mismos eventos que en modo texto
+				self.eventos.append(('bloque', (self.reloj.a_hora(valor[0]), valor[0])))
+				for v in valor[1]:
+					self.eventos.append(('telemetria', 5.0 * v / 1023))
+			elif letra == 'L':
+				self.eventos.append(('latencia', (valor[0] / self.reloj.hz, valor[1] / self.reloj.hz)))
+			elif letra == 'U':
+				self.eventos.append(('arranque', a_arranque(valor)))
+			elif letra == 'A':
+				self._respondido(valor[0], valor[2])
+			elif letra == 'Y':
+				indice, total, registros = valor
+				if indice == 0:
+					self._traza = []
+				if indice == len(self._traza):	# sin huecos
+					self._traza += registros
+					if len(self._traza) == total:
+						self.eventos.append(('traza', self._traza))
+						self._traza = []
+			elif letra == 'R' and self._ping_enviado is not None:
+				self.reloj.ping(self._ping_enviado, valor, recibido)
+				self._ping_enviado = None
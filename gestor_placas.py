@@ -0,0 +1,392 @@
+import os
+import sys
+import json
+import time
+import socket
+import selectors
+import argparse
+import collections
+import serial                       # LIBRERIA PARA PUERTO SERIAL
+import serial.tools.list_ports
+
+from enlace import Tramas, VENTANA_MAXIMA
+
+# -----------------------------------------------------------------------------------
+# Gestor de todas las placas conectadas al PC, en un solo proceso y un solo hilo.
+#
+#	python gestor_placas.py [--socket RUTA] [--tty RUTA ...]
+#
+# Cada cierto tiempo busca los puertos CDC cuyo VID/PID coinciden con los de
+# nuestras placas y las identifica por su numero de serie. Si dos placas
+# conectadas tienen el mismo numero (firmware sin serie propio, ver
+# usb_desc_adq.h) se avisa y esas se identifican por la ruta del tty. Con
+# USB_CDC_CTL cada placa tiene dos puertos: se toma el de datos, el de la
+# interfaz mas baja. Los descriptores de
+# todos los tty y de todos los clientes se atienden con un unico selector
+# (epoll en Linux), asi que 40+ placas no necesitan 40+ hilos.
+#
+# Los clientes hablan por un socket Unix, una orden JSON por linea:
+#	{"cmd": "listar"}
+#		-> {"placas": [{"placa": id, "puerto": tty}, ...]}
+#	{"cmd": "enviar", "placa": id, "datos": "S121$", "sec": n}	(sec opcional)
+#		-> {"ok": true} o {"error": "..."}; las respuestas sin numero de la placa
+#		   (R, L, U) van al ultimo cliente que le envio algo, con su sec:
+#		   {"evento": "respuesta", "placa": id, "sec": n, "letra": "L", "valor": [3, 9]}
+#	{"cmd": "pedir", "placa": id, "orden": 125, "sec": n}
+#		-> {"ok": true} y luego, solo a ese cliente, la respuesta al pedido
+#		   numerado Q<ss><ccc>$ (letra null si la orden no devuelve nada):
+#		   {"evento": "respuesta", "placa": id, "sec": n, "orden": 125, "letra": "U",
+#		    "valor": [1, 1850, 41237, 41238]}
+#		   o {"evento": "sin_respuesta", "placa": id, "sec": n, "orden": 125}
+#		   si se perdio, vencio o la placa se desconecto
+#	{"cmd": "suscribir", "placa": id}			(id "*" para todas)
+#		-> {"ok": true} y luego, por cada evento de esa placa:
+#		   {"evento": "telemetria", "placa": id, "valor": 1.23}
+#		   {"evento": "bloque", "placa": id, "ticks": 123456}	(marca de reloj.h)
+#		   {"evento": "conectada" | "desconectada", "placa": id}
+#
+# Para pruebas de carga, simulador_placas.py crea placas falsas sobre
+# pseudo-terminales; sus rutas se pasan con --tty.
+
+IDS_USB = [(0x0461, 0x0033),		# CCS CDC (usb_desc_cdc.h)
+		   (0x04D8, 0x000A)]		# Microchip CDC
+SOCKET = '/tmp/gestor_placas.sock'
+REVISAR = 2.0						# segundos entre busquedas de placas
+MAX_SALIDA = 1 << 20				# bytes pendientes antes de soltar un cliente lento
+ESPERA_RESPUESTA = 1.0				# segundos antes de dar un pedido por perdido
+
+class Placa:
+
+	def __init__(self, id, puerto):
+		self.id = id
+		self.puerto = puerto
+		self.serie = serial.Serial(puerto, 115200, timeout=0)
+		self.fd = self.serie.fileno()
+		os.set_blocking(self.fd, False)
+		self.tramas = Tramas()
+		self.salida = bytearray()
+		self.pedidos = collections.deque()		# (cliente, sec, orden) aun sin enviar
+		self.en_vuelo = collections.OrderedDict()	# ss -> (cliente, sec, orden, hora de envio)
+		self.secuencia = 0
+		self.remitente = None					# (cliente, sec) del ultimo 'enviar'
+
+class Cliente:
+
+	def __init__(self, conexion):
+		self.conexion = conexion
+		self.entrada = bytearray()
+		self.salida = bytearray()
+		self.suscripciones = set()
+
+class Gestor:
+
+	def __init__(self, ruta_socket, ttys=(), ids_usb=IDS_USB):
+		self.selector = selectors.DefaultSelector()
+		self.placas = {}					# id -> Placa
+		self.clientes = []
+		self.ttys = list(ttys)
+		self.ids_usb = ids_usb
+		self.proxima_revision = 0
+		self._repetidos = set()				# numeros de serie ya avisados
+
+		if os.path.exists(ruta_socket):
+			os.unlink(ruta_socket)
+		self.servidor = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+		self.servidor.bind(ruta_socket)
+		self.servidor.listen(16)
+		self.servidor.setblocking(False)
+		self.selector.register(self.servidor, selectors.EVENT_READ, self._aceptar)
+
+	# ---------------------------------------------------------------------------
+	# lazo principal
+
+	def correr(self):
+		while True:
+			if time.monotonic() >= self.proxima_revision:
+				self._descubrir()
+				self.proxima_revision = time.monotonic() + REVISAR
+			self._vencer()
+			espera = max(0, self.proxima_revision - time.monotonic())
+			if any(p.en_vuelo for p in self.placas.values()):
+				espera = min(espera, ESPERA_RESPUESTA / 4)
+			for clave, eventos in self.selector.select(espera):
+				clave.data(clave.fileobj, eventos)
+
+	# ---------------------------------------------------------------------------
+	# descubrimiento de placas
+
+	def _descubrir(self):
+		vistos = dict(self._puertos_usb())
+		for tty in self.ttys:
+			vistos[tty] = tty
+
+		for id, puerto in vistos.items():
+			if id not in self.placas:
+				try:
+					self._agregar(Placa(id, puerto))
+				except (serial.SerialException, OSError):
+					pass
+		for id in [id for id in self.placas if id not in vistos]:
+			self._quitar(self.placas[id])
+
+	def _puertos_usb(self):
+		# (id, tty) de cada placa USB conectada
+		dispositivos = {}
+		puertos = [p for p in serial.tools.list_ports.comports() if (p.vid, p.pid) in self.ids_usb]
+		for p in sorted(puertos, key=lambda p: p.location or ''):
+			# location: '1-1.4:1.0' -> dispositivo '1-1.4', interfaz 0
+			dispositivo = p.location.split(':')[0] if p.location else p.device
+			dispositivos.setdefault(dispositivo, p)
+
+		series = collections.Counter(p.serial_number for p in dispositivos.values())
+		for p in dispositivos.values():
+			if not p.serial_number:
+				yield p.device, p.device
+			elif series[p.serial_number] > 1:
+				if p.serial_number not in self._repetidos:
+					self._repetidos.add(p.serial_number)
+					print('aviso: %d placas con numero de serie %s; se usa la ruta del tty'
+						  % (series[p.serial_number], p.serial_number), file=sys.stderr)
+				yield p.device, p.device
+			else:
+				yield p.serial_number, p.device
+
+	def _agregar(self, placa):
+		self.placas[placa.id] = placa
+		self.selector.register(placa.fd, selectors.EVENT_READ,
+			lambda fd, ev: self._atender_placa(placa, ev))
+		self._publicar(placa.id, {'evento': 'conectada', 'placa': placa.id})
+
+	def _quitar(self, placa):
+		if self.placas.get(placa.id) is not placa:
+			return
+		del self.placas[placa.id]
+		self.selector.unregister(placa.fd)
+		placa.serie.close()
+		for cliente, sec, orden, enviado in placa.en_vuelo.values():
+			self._sin_respuesta(placa, cliente, sec, orden)
+		for cliente, sec, orden in placa.pedidos:
+			self._sin_respuesta(placa, cliente, sec, orden)
+		placa.en_vuelo.clear()
+		placa.pedidos.clear()
+		self._publicar(placa.id, {'evento': 'desconectada', 'placa': placa.id})
+
+	def _atender_placa(self, placa, eventos):
+		try:
+			if eventos & selectors.EVENT_READ:
+				datos = os.read(placa.fd, 4096)
+				if not datos:
+					raise OSError('fin de archivo')
+				for letra, valor in placa.tramas.alimentar(datos):
+					if letra == 'I':
+						self._publicar(placa.id, {'evento': 'telemetria', 'placa': placa.id,
+												  'valor': valor})
+					elif letra == 'T':
+						self._publicar(placa.id, {'evento': 'bloque', 'placa': placa.id,
+												  'ticks': valor})
+					elif letra == 'Z':			# bloque compacto: como en modo texto
+						self._publicar(placa.id, {'evento': 'bloque', 'placa': placa.id,
+												  'ticks': valor[0]})
+						for v in valor[1]:
+							self._publicar(placa.id, {'evento': 'telemetria', 'placa': placa.id,
+													  'valor': round(5.0 * v / 1023, 3)})
+					elif letra == 'A':
+						self._respondido(placa, *valor)
+					elif letra in 'RLU' and placa.remitente is not None:
+						cliente, sec = placa.remitente
+						self._a_cliente(cliente, {'evento': 'respuesta', 'placa': placa.id, 'sec': sec,
+												  'letra': letra, 'valor': valor})
+			if eventos & selectors.EVENT_WRITE:
+				self._vaciar_placa(placa)
+		except BlockingIOError:
+			pass
+		except OSError:						# se desconecto la placa
+			self._quitar(placa)
+
+	def _vaciar_placa(self, placa):
+		try:
+			n = os.write(placa.fd, placa.salida)
+			del placa.salida[:n]
+		except BlockingIOError:
+			pass
+		self.selector.modify(placa.fd,
+			selectors.EVENT_READ | (selectors.EVENT_WRITE if placa.salida else 0),
+			self.selector.get_key(placa.fd).data)
+
+	# ---------------------------------------------------------------------------
+	# pedidos numerados: la placa contesta en orden A<ss>..F y la respuesta
+	# vuelve solo al cliente que pidio
+
+	def _despachar(self, placa):
+		# llena la ventana de la placa (PEDIDOS en pic18f_ejemplo.c)
+		datos = b''
+		ahora = time.monotonic()
+		while placa.pedidos and len(placa.en_vuelo) < VENTANA_MAXIMA:
+			cliente, sec, orden = placa.pedidos.popleft()
+			ss = placa.secuencia
+			placa.secuencia = (ss + 1) & 0xFF
+			placa.en_vuelo[ss] = (cliente, sec, orden, ahora)
+			datos += b'Q%02x%03d$' % (ss, orden)
+		if datos:
+			placa.salida += datos
+			self._vaciar_placa(placa)
+
+	def _respondido(self, placa, ss, letra, valor):
+		if ss not in placa.en_vuelo:
+			return								# ya vencido
+		while True:								# en orden: los anteriores se perdieron
+			s, (cliente, sec, orden, enviado) = placa.en_vuelo.popitem(last=False)
+			if s == ss:
+				break
+			self._sin_respuesta(placa, cliente, sec, orden)
+		self._a_cliente(cliente, {'evento': 'respuesta', 'placa': placa.id, 'sec': sec,
+								  'orden': orden, 'letra': letra, 'valor': valor})
+		self._despachar(placa)
+
+	def _vencer(self):
+		limite = time.monotonic() - ESPERA_RESPUESTA
+		for placa in list(self.placas.values()):
+			vencido = False
+			while placa.en_vuelo:
+				ss, (cliente, sec, orden, enviado) = next(iter(placa.en_vuelo.items()))
+				if enviado > limite:
+					break
+				del placa.en_vuelo[ss]
+				self._sin_respuesta(placa, cliente, sec, orden)
+				vencido = True
+			if vencido:
+				try:
+					self._despachar(placa)
+				except OSError:
+					self._quitar(placa)
+
+	def _sin_respuesta(self, placa, cliente, sec, orden):
+		self._a_cliente(cliente, {'evento': 'sin_respuesta', 'placa': placa.id, 'sec': sec,
+								  'orden': orden})
+
+	# ---------------------------------------------------------------------------
+	# clientes del socket
+
+	def _aceptar(self, servidor, eventos):
+		conexion, _ = servidor.accept()
+		conexion.setblocking(False)
+		cliente = Cliente(conexion)
+		self.clientes.append(cliente)
+		self.selector.register(conexion, selectors.EVENT_READ,
+			lambda c, ev: self._atender_cliente(cliente, ev))
+
+	def _soltar(self, cliente):
+		if cliente in self.clientes:
+			self.clientes.remove(cliente)
+			self.selector.unregister(cliente.conexion)
+			cliente.conexion.close()
+
+	def _atender_cliente(self, cliente, eventos):
+		try:
+			if eventos & selectors.EVENT_READ:
+				datos = cliente.conexion.recv(4096)
+				if not datos:
+					self._soltar(cliente)
+					return
+				cliente.entrada += datos
+				while b'\n' in cliente.entrada:
+					linea, _, resto = bytes(cliente.entrada).partition(b'\n')
+					cliente.entrada = bytearray(resto)
+					self._responder(cliente, self._orden(cliente, linea))
+			if eventos & selectors.EVENT_WRITE:
+				self._vaciar_cliente(cliente)
+		except BlockingIOError:
+			pass
+		except OSError:
+			self._soltar(cliente)
+
+	def _orden(self, cliente, linea):
+		try:
+			orden = json.loads(linea)
+			cmd = orden['cmd']
+		except (ValueError, KeyError, TypeError):
+			return {'error': 'orden invalida'}
+
+		if cmd == 'listar':
+			return {'placas': [{'placa': p.id, 'puerto': p.puerto} for p in self.placas.values()]}
+
+		if cmd == 'suscribir':
+			cliente.suscripciones.add(orden.get('placa', '*'))
+			return {'ok': True}
+
+		if cmd == 'enviar':
+			placa = self.placas.get(orden.get('placa'))
+			if placa is None:
+				return {'error': 'placa desconocida'}
+			placa.salida += orden.get('datos', '').encode('latin-1')
+			placa.remitente = (cliente, orden.get('sec'))
+			try:
+				self._vaciar_placa(placa)
+			except OSError:
+				self._quitar(placa)
+				return {'error': 'placa desconectada'}
+			return {'ok': True}
+
+		if cmd == 'pedir':
+			placa = self.placas.get(orden.get('placa'))
+			if placa is None:
+				return {'error': 'placa desconocida'}
+			numero = orden.get('orden')
+			if not isinstance(numero, int) or not 0 <= numero <= 999:
+				return {'error': 'orden invalida'}
+			placa.pedidos.append((cliente, orden.get('sec'), numero))
+			try:
+				self._despachar(placa)
+			except OSError:
+				self._quitar(placa)
+				return {'error': 'placa desconectada'}
+			return {'ok': True}
+
+		return {'error': 'orden desconocida'}
+
+	def _publicar(self, id, mensaje):
+		for cliente in list(self.clientes):
+			if id in cliente.suscripciones or '*' in cliente.suscripciones:
+				self._responder(cliente, mensaje)
+
+	def _a_cliente(self, cliente, mensaje):
+		# respuesta para un cliente que quizas ya se fue
+		if cliente in self.clientes:
+			self._responder(cliente, mensaje)
+
+	def _responder(self, cliente, mensaje):
+		cliente.salida += json.dumps(mensaje).encode() + b'\n'
+		if len(cliente.salida) > MAX_SALIDA:	# no lee: no puede frenar a los demas
+			self._soltar(cliente)
+			return
+		try:
+			self._vaciar_cliente(cliente)
+		except OSError:
+			self._soltar(cliente)
+
+	def _vaciar_cliente(self, cliente):
+		try:
+			n = cliente.conexion.send(cliente.salida)
+			del cliente.salida[:n]
+		except BlockingIOError:
+			pass
+		self.selector.modify(cliente.conexion,
+			selectors.EVENT_READ | (selectors.EVENT_WRITE if cliente.salida else 0),
+			self.selector.get_key(cliente.conexion).data)
+
+# -----------------------------------------------------------------------------------
+
+def main():
+	parser = argparse.ArgumentParser(description='Gestor de placas PIC18F2550 por USB CDC')
+	parser.add_argument('--socket', default=SOCKET, help='ruta del socket Unix')
+	parser.add_argument('--tty', nargs='*', default=[], help='puertos a abrir ademas de los detectados')
+	args = parser.parse_args()
+
+	gestor = Gestor(args.socket, args.tty)
+	try:
+		gestor.correr()
+	except KeyboardInterrupt:
+		return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
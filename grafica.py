@@ -0,0 +1,150 @@
+import time
+import collections
+from array import array
+from tkinter import Canvas
+
+# -----------------------------------------------------------------------------------
+# Grafica en vivo de la telemetria, para cualquier ventana de tkinter.
+#
+#	grafica = Grafica(root, muestras=5000)
+#	grafica.grid(...)
+#	... por cada evento ('telemetria', v) de EnlaceSerie: grafica.agregar(v)
+#
+# Las muestras van a un anillo de tamano fijo (la memoria no crece) y, al
+# llegar, a un decimador que guarda el minimo y el maximo de cada columna de
+# pantalla. Dibujar cuesta lo mismo a 10 muestras/s que a 100000: una sola
+# linea de 2 puntos por columna (la envolvente min/max, asi un pico de una
+# muestra no desaparece), que se redibuja a lo sumo 'fps' veces por segundo y
+# solo si llegaron datos. El anillo solo se recorre al cambiar el ancho.
+
+class Anillo:
+
+	def __init__(self, capacidad):
+		self.capacidad = capacidad
+		self.datos = array('f', bytes(4 * capacidad))
+		self.escritas = 0
+
+	def agregar(self, valor):
+		self.datos[self.escritas % self.capacidad] = valor
+		self.escritas += 1
+
+	def __len__(self):
+		return min(self.escritas, self.capacidad)
+
+	def __iter__(self):
+		# de la mas vieja a la mas nueva
+		inicio = self.escritas - len(self)
+		for i in range(inicio, self.escritas):
+			yield self.datos[i % self.capacidad]
+
+class Decimador:
+
+	def __init__(self, columnas, por_columna):
+		self.por_columna = max(1, por_columna)
+		self.minimos = collections.deque(maxlen=columnas)
+		self.maximos = collections.deque(maxlen=columnas)
+		self._n = 0
+
+	def agregar(self, valor):
+		if self._n == 0:
+			self._min = self._max = valor
+		elif valor < self._min:
+			self._min = valor
+		elif valor > self._max:
+			self._max = valor
+		self._n += 1
+		if self._n == self.por_columna:			# columna completa
+			self.minimos.append(self._min)
+			self.maximos.append(self._max)
+			self._n = 0
+
+	def columnas(self):
+		# (min, max) de cada columna, incluida la que se esta llenando
+		pares = list(zip(self.minimos, self.maximos))
+		if self._n:
+			pares.append((self._min, self._max))
+		return pares
+
+class Grafica(Canvas):
+
+	def __init__(self, padre, muestras=5000, rango=(0.0, 5.0), fps=30, **opciones):
+		opciones.setdefault('width', 500)
+		opciones.setdefault('height', 200)
+		opciones.setdefault('background', 'black')
+		opciones.setdefault('highlightthickness', 0)
+		Canvas.__init__(self, padre, **opciones)
+		self.muestras = muestras				# largo de la ventana visible
+		self.rango = rango						# valores en el borde inferior y superior
+		self.periodo = int(1000 / fps)
+		self.anillo = Anillo(muestras)
+		self.ancho = int(opciones['width'])
+		self.alto = int(opciones['height'])
+		self._rehacer()
+		self._sucia = False
+		self._cuenta = (time.monotonic(), 0)
+		self.tasa = 0.0							# muestras por segundo recibidas
+
+		for i in range(3):						# reticula fija, en cuartos
+			self.create_line(0, 0, 0, 0, fill='gray25', tags='reticula')
+		self._texto = self.create_text(4, 2, anchor='nw', fill='gray60', font=('TkFixedFont', 8))
+		self._linea = self.create_line(0, 0, 0, 0, fill='lime green')
+		self._reticula()
+
+		self.bind('<Configure>', self._al_cambiar)
+		self.after(self.periodo, self._dibujar)
+
+	def agregar(self, valor):
+		self.anillo.agregar(valor)
+		self.decimador.agregar(valor)
+		self._sucia = True
+
+	def limpiar(self):
+		self.anillo = Anillo(self.muestras)
+		self._rehacer()
+		self._sucia = True
+
+	def _rehacer(self):
+		# arma el decimador para el ancho actual con lo que haya en el anillo
+		self.decimador = Decimador(self.ancho, -(-self.muestras // self.ancho))
+		for valor in self.anillo:
+			self.decimador.agregar(valor)
+
+	def _al_cambiar(self, evento):
+		if evento.width != self.ancho or evento.height != self.alto:
+			self.ancho, self.alto = evento.width, evento.height
+			self._rehacer()
+			self._reticula()
+			self._sucia = True
+
+	def _reticula(self):
+		for i, linea in enumerate(self.find_withtag('reticula')):
+			y = self.alto * (i + 1) / 4
+			self.coords(linea, 0, y, self.ancho, y)
+
+	def _y(self, valor):
+		bajo, alto = self.rango
+		return (self.alto - 1) * (1 - (valor - bajo) / (alto - bajo))
+
+	def _dibujar(self):
+		self.after(self.periodo, self._dibujar)
+
+		ahora = time.monotonic()
+		inicio, escritas = self._cuenta
+		if ahora - inicio >= 1:
+			self.tasa = (self.anillo.escritas - escritas) / (ahora - inicio)
+			self._cuenta = (ahora, self.anillo.escritas)
+			self.itemconfig(self._texto, text='%d muestras  %.0f/s  %g..%g'
+							% (self.muestras, self.tasa, self.rango[0], self.rango[1]))
+
+		if not self._sucia:
+			return
+		self._sucia = False
+
+		pares = self.decimador.columnas()
+		x0 = self.ancho - len(pares)			# lo mas nuevo a la derecha
+		puntos = []
+		for x, (minimo, maximo) in enumerate(pares, x0):
+			puntos += (x, self._y(maximo), x, self._y(minimo))
+		if not puntos:
+			puntos = [0, 0, 0, 0]
+		self.coords(self._linea, *puntos)
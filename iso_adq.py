@@ -0,0 +1,120 @@
+import sys
+import time
+import usb1                         # LIBRERIA libusb1 (transferencias asincronas)
+
+from codec import bloque_con_marca, BLOQUE
+
+# -----------------------------------------------------------------------------------
+# Lectura de las muestras por el endpoint isocrono (pic18f2550ccs/adq_iso.h).
+#
+#	python iso_adq.py [VID PID]
+#
+# Se elige la alternativa 1 de la interfaz 2, que reserva el ancho de banda,
+# y se mantienen varias transferencias asincronas en cola para que el host
+# pida un paquete en cada trama de 1ms sin huecos. El CDC (interfaces 0 y 1)
+# sigue en manos del driver del sistema.
+#
+# Por cada paquete se cuentan:
+#	vacias    tramas reservadas en las que no llego paquete (o llego con error)
+#	perdidos  paquetes que el PIC envio y no llegaron (salto en la secuencia)
+
+VID = 0x04D8
+PID = 0x000A
+INTERFAZ = 2						# USB_ADQ_ISO_INTERFACE
+ENDPOINT = 0x83						# USB_ADQ_ISO_ENDPOINT | 0x80
+TAMANO = 64							# USB_ADQ_ISO_SIZE
+
+class LectorIso:
+
+	def __init__(self, al_recibir, vid=VID, pid=PID, paquetes=32, transferencias=4):
+		# al_recibir(ticks, valores): un bloque de muestras de 10 bits
+		self.al_recibir = al_recibir
+		self.paquetes = 0
+		self.bloques = 0
+		self.vacias = 0
+		self.perdidos = 0
+		self._secuencia = None
+
+		self.contexto = usb1.USBContext()
+		self.placa = self.contexto.openByVendorIDAndProductID(vid, pid, skip_on_error=True)
+		if self.placa is None:
+			raise IOError('no se encontro la placa %04X:%04X' % (vid, pid))
+		self.placa.claimInterface(INTERFAZ)
+		self.placa.setInterfaceAltSetting(INTERFAZ, 1)		# reserva el ancho de banda
+
+		self.transferencias = []
+		for i in range(transferencias):
+			t = self.placa.getTransfer(iso_packets=paquetes)
+			t.setIsochronous(ENDPOINT, paquetes * TAMANO, callback=self._completada)
+			t.submit()
+			self.transferencias.append(t)
+
+	def atender(self, espera=0.1):
+		# procesa las transferencias completadas; llamar en un lazo
+		self.contexto.handleEventsTimeout(espera)
+
+	def cerrar(self):
+		for t in self.transferencias:
+			try:
+				t.cancel()
+			except usb1.USBError:
+				pass
+		while any(t.isSubmitted() for t in self.transferencias):
+			self.contexto.handleEventsTimeout(0.1)
+		self.placa.setInterfaceAltSetting(INTERFAZ, 0)		# libera el ancho de banda
+		self.placa.releaseInterface(INTERFAZ)
+		self.placa.close()
+		self.contexto.close()
+
+	def _completada(self, transferencia):
+		if transferencia.getStatus() != usb1.TRANSFER_COMPLETED:
+			return							# cancelada al cerrar
+		for estado, datos in transferencia.iterISO():
+			if estado != usb1.TRANSFER_COMPLETED or len(datos) < 2:
+				self.vacias += 1
+				continue
+			self._paquete(bytes(datos))
+		transferencia.submit()				# vuelve a la cola enseguida
+
+	def _paquete(self, datos):
+		self.paquetes += 1
+		secuencia, n = datos[0], datos[1]
+		if self._secuencia is not None:
+			self.perdidos += (secuencia - self._secuencia - 1) & 0xFF
+		self._secuencia = secuencia
+
+		# cada bloque: ticks(4) + bloque de codec.h (empacado o delta)
+		pos = 2
+		for i in range(n):
+			ticks, valores, pos = bloque_con_marca(datos, pos, BLOQUE)
+			self.bloques += 1
+			self.al_recibir(ticks, valores)
+
+# -----------------------------------------------------------------------------------
+
+def main():
+	vid = int(sys.argv[1], 16) if len(sys.argv) > 2 else VID
+	pid = int(sys.argv[2], 16) if len(sys.argv) > 2 else PID
+
+	ultimo = [None]
+	def mostrar(ticks, valores):
+		ultimo[0] = 5.0 * valores[-1] / 1023
+
+	lector = LectorIso(mostrar, vid, pid)
+	try:
+		t0 = time.monotonic()
+		while True:
+			lector.atender()
+			if time.monotonic() - t0 >= 1:
+				t0 = time.monotonic()
+				print('paquetes %d  bloques %d  vacias %d  perdidos %d  ultimo %s'
+					  % (lector.paquetes, lector.bloques, lector.vacias, lector.perdidos,
+						 '---' if ultimo[0] is None else '%1.2f V' % ultimo[0]))
+	except KeyboardInterrupt:
+		pass
+	finally:
+		lector.cerrar()
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,582 @@
+import os
+import re
+import sys
+import json
+import argparse
+
+# -----------------------------------------------------------------------------------
+# Analisis estatico del peor caso a partir de la salida del compilador CCS.
+#
+#	python peor_caso.py pic18f2550ccs/main [--cotas pic18f2550ccs/cotas.txt]
+#	python peor_caso.py pic18f2550ccs/main --guardar base.json
+#	python peor_caso.py pic18f2550ccs/main --comparar base.json
+#
+# Lee main.lst (instrucciones), main.sym (direccion de cada funcion), main.tre
+# (arbol de llamadas con la RAM de cada funcion) y main.STA (resumen) y saca:
+#	- ciclos de instruccion del peor camino de cada funcion, con sus llamadas
+#	- peor caso de cada vector de interrupcion, con el camino de funciones
+#	- ciclos de una vuelta de cada lazo (la del lazo principal es el tiempo
+#	  maximo entre dos usb_task())
+#	- pila de hardware y RAM del peor camino de llamadas
+#
+# Cada rama condicional toma el lado mas caro (2 ciclos si salta, 3 si un
+# BTFSx salta una instruccion de dos palabras). CCS pone en linea las funciones
+# que se llaman una sola vez y entra a ellas con BRA/GOTO en vez de RCALL; el
+# analisis sigue esos saltos como llamadas que no ocupan pila.
+#
+# Los lazos con cuenta fija (MOVLW k ... DECFSZ) se acotan solos; el resto
+# necesita el maximo de veces que se ejecuta el cuerpo en el archivo de cotas
+# (por defecto cotas.txt junto a la compilacion):
+#	funcion  [CABECERA]  iteraciones		# sin cabecera: todos sus lazos
+# Sin cota, la funcion (y quien la llame) queda "sin cota" y se informa la
+# vuelta del lazo y su cabecera para anotarla. Las cotas son superiores: se
+# puede contar una vuelta de mas.
+#
+# Con --comparar se marca cualquier aumento de ciclos, pila, RAM o ROM frente
+# a un informe guardado antes (o a otra compilacion) y el programa termina con
+# codigo 1, para cortar un script de compilacion antes de grabar el PIC.
+
+DOS_PALABRAS = {'MOVFF', 'LFSR', 'GOTO', 'CALL', 'MOVSF', 'MOVSS'}
+SALTOS_COND = {'BC', 'BNC', 'BN', 'BNN', 'BOV', 'BNOV', 'BZ', 'BNZ'}
+SALTEOS = {'BTFSC', 'BTFSS', 'DECFSZ', 'INCFSZ', 'DCFSNZ', 'INFSNZ',
+		   'CPFSEQ', 'CPFSGT', 'CPFSLT', 'TSTFSZ'}
+RETORNOS = {'RETURN', 'RETFIE', 'RETLW'}
+LLAMADAS = {'CALL', 'RCALL'}
+DOS_CICLOS = {'BRA', 'GOTO', 'CALL', 'RCALL', 'RETURN', 'RETFIE', 'RETLW', 'MOVFF',
+			  'LFSR', 'MOVSF', 'MOVSS', 'TBLRD*', 'TBLRD*+', 'TBLRD*-', 'TBLRD+*',
+			  'TBLWT*', 'TBLWT*+', 'TBLWT*-', 'TBLWT+*'}
+PCL = 0xFF9
+
+VECTORES = [(0x0000, '@reset'), (0x0008, '@interrupcion'), (0x0018, '@interrupcion_baja')]
+
+RE_INSTR = re.compile(r'^([0-9A-F]{4,6}):  (\S+)\s*(.*?)\s*$')
+RE_HEX = re.compile(r'\b([0-9A-F]{3,6})\b')
+
+# -----------------------------------------------------------------------------------
+# lectura de los archivos del compilador
+
+class Instruccion:
+
+	def __init__(self, dir, nem, ops):
+		self.dir = dir
+		self.nem = nem
+		self.ops = ops
+		self.sig = None					# direccion de la instruccion siguiente
+
+	def destino(self):
+		m = RE_HEX.search(self.ops)
+		return int(m.group(1), 16) if m else None
+
+	def escribe_pcl(self):
+		# salto calculado: MOVWF PCL, ADDWF PCL,F, MOVFF x,PCL...
+		if self.nem in ('MOVWF', 'CLRF', 'SETF') or ',F' in self.ops or self.nem == 'MOVFF':
+			campos = self.ops.replace(',F', '').split(',')
+			try:
+				return int(campos[-1].strip(), 16) == PCL
+			except ValueError:
+				return False
+		return False
+
+def leer_lst(ruta):
+	instrucciones = {}
+	anterior = None
+	for linea in open(ruta, encoding='latin-1'):
+		m = RE_INSTR.match(linea)
+		if not m:
+			continue
+		i = Instruccion(int(m.group(1), 16), m.group(2), m.group(3))
+		if i.nem == 'DATA':
+			anterior = None
+			continue
+		if anterior is not None and anterior.sig is None:
+			anterior.sig = i.dir
+		instrucciones[i.dir] = i
+		anterior = i
+	for i in instrucciones.values():
+		tam = 4 if i.nem in DOS_PALABRAS else 2
+		if i.sig is None or i.sig != i.dir + tam:
+			i.sig = i.dir + tam
+	return instrucciones
+
+def leer_sym(ruta):
+	# direcciones de la seccion "ROM Allocation"; las tablas .data no son codigo
+	funciones = {}
+	en_rom = False
+	for linea in open(ruta, encoding='latin-1'):
+		linea = linea.rstrip()
+		if linea.startswith('ROM Allocation'):
+			en_rom = True
+			continue
+		if en_rom:
+			campos = linea.split()
+			if len(campos) != 2:
+				break
+			dir, nombre = int(campos[0], 16), campos[1]
+			if funciones and dir < max(funciones):
+				break						# siguen las etiquetas de las tablas
+			if nombre.endswith('.data') or nombre.startswith('@cinit'):
+				continue					# tablas y la inicializacion dentro de main()
+			if dir not in funciones or funciones[dir].startswith('@'):
+				funciones[dir] = nombre
+	return funciones
+
+def leer_tre(ruta):
+	# {funcion: (ram, [hijos])}; una funcion que ya aparecio se repite con '*'
+	# en lugar de sus hijos, asi que se guarda la aparicion con mas hijos
+	arbol = {}
+	pila = []
+	for linea in open(ruta, encoding='latin-1'):
+		m = re.search(r'[A-Za-z_@*]', linea)
+		if not m:
+			continue
+		nivel = max(0, (m.start() - 2) // 3)
+		campos = linea[m.start():].split()
+		ram = [int(c[4:]) for c in campos if c.startswith('Ram=')]
+		del pila[nivel:]
+		nodo = (campos[0], ram[0] if ram else 0, [])
+		if pila and nodo[0] != '*':
+			pila[-1][2].append(nodo[0])
+		if nodo[0] != '*' and len(arbol.get(nodo[0], (0, []))[1]) <= 0:
+			arbol[nodo[0]] = (nodo[1], nodo[2])
+		pila.append(nodo)
+	return arbol
+
+def leer_sta(ruta):
+	sta = {'funciones': {}}
+	texto = open(ruta, encoding='latin-1').read()
+	m = re.search(r'ROM used:\s+(\d+)/(\d+)', texto)
+	if m:
+		sta['rom'] = int(m.group(1))
+	m = re.search(r'RAM used:\s+(\d+)/\d+.*\n\s+(\d+)/\d+ .*worst case', texto)
+	if m:
+		sta['ram_main'], sta['ram'] = int(m.group(1)), int(m.group(2))
+	m = re.search(r'Stack used:\s+(\d+) worst case \((\d+) in main \+ (\d+) for interrupts\)', texto)
+	if m:
+		sta['pila'], sta['pila_main'], sta['pila_int'] = (int(g) for g in m.groups())
+	for linea in texto.splitlines():
+		campos = linea.split()
+		if len(campos) >= 5 and campos[0].isdigit() and campos[1].isdigit() and campos[2].isdigit():
+			sta['funciones'][campos[-1]] = int(campos[1])
+	return sta
+
+# -----------------------------------------------------------------------------------
+# analisis de ciclos y pila
+
+class Resultado:
+
+	def __init__(self, nombre):
+		self.nombre = nombre
+		self.ciclos = 0				# peor camino, con las llamadas y lazos acotados
+		self.acotado = True			# False si algun lazo (propio o de una llamada) no tiene cota
+		self.pila = 0				# niveles de pila de hardware usados debajo de esta funcion
+		self.camino = [nombre]		# funciones del peor camino de ciclos
+		self.camino_pila = [nombre]
+		self.salidas = set()		# saltos a otras funciones que no vuelven (BRA/GOTO de salida)
+		self.retorna = False		# termina con RETURN/RETFIE
+		self.lazos = []				# (cabecera, ciclos por vuelta, iteraciones o None)
+		self.avisos = []
+
+class Analizador:
+
+	def __init__(self, instrucciones, funciones, cotas):
+		self.ins = instrucciones
+		self.inicios = dict(funciones)
+		for dir, nombre in VECTORES:
+			if dir in instrucciones and dir not in self.inicios and self._es_vector(dir):
+				self.inicios[dir] = nombre
+		self.orden = sorted(self.inicios)
+		self.cotas = cotas
+		self.hechos = {}
+		self.en_curso = set()
+
+	def _es_vector(self, dir):
+		# sin HIGH_INTS el despachador de 0x0008 sigue de largo por 0x0018
+		if dir != 0x0018:
+			return True
+		return any(i.nem in ('RETFIE', 'GOTO', 'BRA') for d, i in self.ins.items()
+				   if 0x0008 <= d < 0x0018)
+
+	def rango(self, dir):
+		# [inicio, fin) de la funcion que contiene dir
+		inicio = max((d for d in self.orden if d <= dir), default=0)
+		fin = min((d for d in self.orden if d > inicio), default=1 << 24)
+		return inicio, fin
+
+	def cota(self, nombre, cabecera):
+		return self.cotas.get((nombre, cabecera), self.cotas.get((nombre, None)))
+
+	def funcion(self, dir):
+		if dir in self.hechos:
+			return self.hechos[dir]
+		inicio, fin = self.rango(dir)
+		nombre = self.inicios.get(dir, '%s+%X' % (self.inicios.get(inicio, '?'), dir - inicio))
+		r = Resultado(nombre)
+		if dir in self.en_curso:				# recursion: CCS no la permite
+			r.acotado = False
+			r.avisos.append('recursion en %s' % nombre)
+			return r
+		self.en_curso.add(dir)
+		self._analizar(r, dir, inicio, fin)
+		self.en_curso.discard(dir)
+		self.hechos[dir] = r
+		return r
+
+	def _contador(self, cabecera, colas):
+		# lazo de CCS con cuenta fija: MOVLW k / MOVWF r / ... / DECFSZ r,F / BRA cabecera
+		for u in colas:
+			anterior = [i for i in self.ins.values() if i.sig == u]
+			if self.ins[u].nem != 'BRA' or not anterior or anterior[0].nem != 'DECFSZ':
+				return None
+			registro = anterior[0].ops.split(',')[0]
+		previas = sorted((d for d in self.ins if cabecera - 8 <= d < cabecera))
+		for a, b in zip(previas, previas[1:]):
+			if (self.ins[a].nem == 'MOVLW' and self.ins[b].nem == 'MOVWF'
+					and self.ins[b].ops == registro):
+				return int(self.ins[a].ops, 16) or 256
+		return None
+
+	def _sucesores(self, r, i, inicio, fin):
+		# [(destino o None si sale, ciclos, llamada)] de la instruccion i
+		n = i.nem
+		if n in RETORNOS:
+			r.retorna = True
+			return [(None, 2, None)]
+		if i.escribe_pcl():
+			r.acotado = False
+			r.avisos.append('salto calculado en %04X' % i.dir)
+			return [(None, 2, None)]
+		if n in ('BRA', 'GOTO'):
+			return [self._salto(r, i.destino(), 2, inicio, fin)]
+		if n in SALTOS_COND:
+			return [(i.sig, 1, None), self._salto(r, i.destino(), 2, inicio, fin)]
+		if n in SALTEOS:
+			salteada = self.ins.get(i.sig)
+			tam = 3 if salteada is not None and salteada.nem in DOS_PALABRAS else 2
+			return [(i.sig, 1, None), (salteada.sig if salteada else i.sig + 2, tam, None)]
+		if n in LLAMADAS:
+			return [(i.sig, 2, self.funcion(i.destino()))]
+		return [(i.sig, 2 if n in DOS_CICLOS else 1, None)]
+
+	def _salto(self, r, destino, ciclos, inicio, fin):
+		if destino is None:
+			r.avisos.append('salto sin destino en %s' % r.nombre)
+			return (None, ciclos, None)
+		if inicio <= destino < fin and destino != inicio:
+			return (destino, ciclos, None)
+		if destino in self.inicios and destino not in self.en_curso:
+			return ('en_linea', ciclos, self.funcion(destino))		# funcion puesta en linea
+		r.salidas.add(destino)
+		return (None, ciclos, None)
+
+	def _analizar(self, r, entrada, inicio, fin):
+		# grafo de la funcion: aristas (origen, destino, ciclos, llamada)
+		aristas = {}
+		pendientes = [entrada]
+		while pendientes:
+			d = pendientes.pop()
+			if d in aristas:
+				continue
+			i = self.ins.get(d)
+			if i is None or not (inicio <= d < fin) or (d == inicio and d != entrada):
+				aristas[d] = [(None, 0, None)]			# se sale cayendo a otra funcion
+				if i is not None:
+					r.salidas.add(d)
+				continue
+			lista = []
+			for destino, ciclos, llamada in self._sucesores(r, i, inicio, fin):
+				if destino == 'en_linea':
+					# vuelve a las direcciones de esta funcion a las que salta la otra
+					vueltas = [s for s in llamada.salidas if inicio <= s < fin]
+					for s in vueltas:
+						lista.append((s, ciclos, llamada))
+					if llamada.retorna or not vueltas:
+						lista.append((None, ciclos, llamada))
+						r.retorna |= llamada.retorna
+					r.salidas |= {s for s in llamada.salidas if not inicio <= s < fin}
+				else:
+					lista.append((destino, ciclos, llamada))
+				if llamada is not None:
+					r.acotado &= llamada.acotado
+					r.avisos += [a for a in llamada.avisos if a not in r.avisos]
+					extra = 1 if i.nem in LLAMADAS else 0		# en linea no ocupa pila
+					if llamada.pila + extra > r.pila:
+						r.pila = llamada.pila + extra
+						r.camino_pila = [r.nombre] + llamada.camino_pila
+			aristas[d] = lista
+			pendientes += [s for s, _, _ in lista if s is not None]
+
+		costo = lambda c, llamada: c + (llamada.ciclos if llamada is not None else 0)
+
+		# aristas de vuelta (DFS iterativo) y orden topologico del resto
+		vuelta = set()
+		orden = []
+		estado = {}
+		pila = [(entrada, iter(aristas[entrada]))]
+		estado[entrada] = 1
+		while pila:
+			d, hijos = pila[-1]
+			for s, _, _ in hijos:
+				if s is None:
+					continue
+				if estado.get(s) == 1:
+					vuelta.add((d, s))
+				elif s not in estado:
+					estado[s] = 1
+					pila.append((s, iter(aristas[s])))
+					break
+			else:
+				estado[d] = 2
+				orden.append(d)
+				pila.pop()
+		orden.reverse()
+
+		# las vueltas extra de cada lazo se cargan al entrar a su cabecera, asi
+		# solo cuentan los lazos que estan en el peor camino
+		extra = {}
+
+		def mas_largo(desde, hasta=None):
+			# peor camino en el grafo sin aristas de vuelta; hasta=None: hasta cualquier salida
+			mejor = {desde: (0 if hasta else extra.get(desde, 0), None)}
+			final = (None, None)
+			for d in orden[orden.index(desde):]:
+				if d not in mejor:
+					continue
+				base = mejor[d][0]
+				for s, c, llamada in aristas[d]:
+					total = base + costo(c, llamada)
+					if (d, s) in vuelta:
+						if hasta is not None and (d, s) == hasta:
+							if final[0] is None or total > final[0]:
+								final = (total, (d, llamada))
+						continue
+					if s is None:
+						if hasta is None and (final[0] is None or total > final[0]):
+							final = (total, (d, llamada))
+						continue
+					total += extra.get(s, 0)
+					if s not in mejor or total > mejor[s][0]:
+						mejor[s] = (total, (d, llamada))
+			return final[0], final[1], mejor
+
+		# lazos: cuerpo natural de cada arista de vuelta, agrupados por cabecera
+		cuerpos = {}
+		for u, h in vuelta:
+			cuerpo = {h}
+			pendientes = [u]
+			while pendientes:
+				d = pendientes.pop()
+				if d in cuerpo:
+					continue
+				cuerpo.add(d)
+				pendientes += [o for o, lista in aristas.items()
+							   if any(s == d for s, _, _ in lista) and (o, d) not in vuelta]
+			cuerpos.setdefault(h, [set(), []])
+			cuerpos[h][0] |= cuerpo
+			cuerpos[h][1].append(u)
+
+		# de adentro hacia afuera: la vuelta de un lazo ya incluye sus lazos internos.
+		# El peor camino pasa una vez por el cuerpo, asi que sobra a lo sumo una vuelta
+		for h in sorted(cuerpos, key=lambda h: len(cuerpos[h][0])):
+			colas = cuerpos[h][1]
+			vuelta_h = max((mas_largo(h, (u, h))[0] or 0) for u in colas)
+			iteraciones = self.cota(r.nombre, h)
+			if iteraciones is None:
+				iteraciones = self._contador(h, colas)
+			if iteraciones is None:
+				r.acotado = False
+			else:
+				extra[h] = iteraciones * vuelta_h
+			r.lazos.append((h, vuelta_h, iteraciones))
+
+		ciclos, ultimo, mejor = mas_largo(entrada)
+		r.ciclos = ciclos or 0
+
+		# funciones del peor camino: la llamada mas cara de ese camino
+		llamadas = []
+		paso = ultimo
+		while paso is not None:
+			d, llamada = paso
+			if llamada is not None:
+				llamadas.append(llamada)
+			paso = mejor[d][1] if d in mejor else None
+		if llamadas:
+			peor = max(llamadas, key=lambda l: l.ciclos)
+			r.camino = [r.nombre] + peor.camino
+
+# -----------------------------------------------------------------------------------
+# RAM del peor camino del arbol de llamadas
+
+def ram_camino(arbol, nombre, visitados=()):
+	if nombre not in arbol or nombre in visitados:
+		return 0, [nombre]
+	ram, hijos = arbol[nombre]
+	peor = (0, [])
+	for h in hijos:
+		peor = max(peor, ram_camino(arbol, h, visitados + (nombre,)))
+	return ram + peor[0], [nombre] + peor[1]
+
+# -----------------------------------------------------------------------------------
+
+def leer_cotas(ruta):
+	cotas = {}
+	if ruta is None:
+		return cotas
+	for linea in open(ruta):
+		campos = linea.split('#')[0].split()
+		if len(campos) == 2:
+			cotas[(campos[0], None)] = int(campos[1])
+		elif len(campos) == 3:
+			cotas[(campos[0], int(campos[1], 16))] = int(campos[2])
+	return cotas
+
+def analizar(base, cotas):
+	instrucciones = leer_lst(base + '.lst')
+	funciones = leer_sym(base + '.sym')
+	arbol = leer_tre(base + '.tre')
+	sta = leer_sta(base + '.STA')
+
+	a = Analizador(instrucciones, funciones, cotas)
+	for dir in sorted(a.inicios):
+		a.funcion(dir)
+
+	informe = {'rom': sta.get('rom'), 'ram': sta.get('ram'), 'pila_ccs': sta.get('pila'),
+			   'funciones': {}, 'vectores': {}, 'lazos': []}
+	for dir, r in sorted(a.hechos.items()):
+		if dir not in a.inicios:
+			continue
+		informe['funciones'][r.nombre] = {
+			'dir': dir, 'ciclos': r.ciclos, 'acotado': r.acotado, 'pila': r.pila,
+			'ram': arbol.get(r.nombre, (None,))[0], 'rom': sta['funciones'].get(r.nombre),
+			'camino': r.camino}
+		for h, vuelta, iteraciones in r.lazos:
+			informe['lazos'].append({'funcion': r.nombre, 'cabecera': h, 'vuelta': vuelta,
+									 'iteraciones': iteraciones})
+
+	# el vector de reset solo salta a MAIN; la pila de las interrupciones se suma
+	# (con HIGH_INTS la alta puede interrumpir a la baja)
+	pila_int = 0
+	for dir, nombre in VECTORES[1:]:
+		if dir in a.hechos:
+			r = a.hechos[dir]
+			pila_int += r.pila + 1
+			informe['vectores'][nombre] = {'ciclos': r.ciclos, 'acotado': r.acotado,
+										   'pila': r.pila + 1, 'camino': r.camino,
+										   'camino_pila': r.camino_pila}
+	principal = informe['funciones'].get('MAIN', {'pila': 0})
+	informe['pila'] = principal['pila'] + pila_int
+
+	for raiz in arbol.get('main', (0, []))[1]:
+		ram, camino = ram_camino(arbol, raiz)
+		informe.setdefault('ram_caminos', {})[raiz] = {'ram': ram, 'camino': camino}
+
+	informe['avisos'] = sorted({av for r in a.hechos.values() for av in r.avisos})
+	return informe
+
+def us(ciclos, mhz):
+	return ciclos * 4.0 / mhz
+
+def mostrar(informe, mhz, plazo):
+	bien = True
+	print('ROM %s  RAM %s (peor caso, CCS)  pila %d niveles (CCS: %s)'
+		  % (informe['rom'], informe['ram'], informe['pila'], informe['pila_ccs']))
+
+	print('\nInterrupciones (a %g MHz):' % mhz)
+	for nombre, v in informe['vectores'].items():
+		marca = '' if v['acotado'] else '  SIN COTA'
+		if plazo is not None and (not v['acotado'] or us(v['ciclos'], mhz) > plazo):
+			marca += '  EXCEDE %g us' % plazo
+			bien = False
+		print('  %-20s %6d ciclos %8.2f us  pila %d%s' % (nombre, v['ciclos'], us(v['ciclos'], mhz),
+													   v['pila'], marca))
+		print('    camino: %s' % ' > '.join(v['camino']))
+		print('    pila:   %s' % ' > '.join(v['camino_pila']))
+
+	if informe.get('ram_caminos'):
+		print('\nRAM local del peor camino de llamadas:')
+		for raiz, v in informe['ram_caminos'].items():
+			print('  %-20s %4d bytes  %s' % (raiz, v['ram'], ' > '.join(v['camino'])))
+
+	print('\nLazos:')
+	for l in informe['lazos']:
+		print('  %-36s %04X  vuelta %6d ciclos %8.2f us  %s'
+			  % (l['funcion'], l['cabecera'], l['vuelta'], us(l['vuelta'], mhz),
+				 'x%d' % l['iteraciones'] if l['iteraciones'] else 'sin cota'))
+
+	print('\n%-36s %8s %5s %5s %5s' % ('Funcion', 'ciclos', 'pila', 'RAM', 'ROM'))
+	for nombre, f in sorted(informe['funciones'].items(), key=lambda f: f[1]['dir']):
+		print('%-36s %7d%s %5d %5s %5s' % (nombre, f['ciclos'], ' ' if f['acotado'] else '+',
+										   f['pila'], '-' if f['ram'] is None else f['ram'],
+										   '-' if f['rom'] is None else f['rom']))
+	print('(+: al menos, hay lazos sin cota)')
+
+	for aviso in informe['avisos']:
+		print('aviso: %s' % aviso)
+	return bien
+
+def comparar(antes, ahora, tolerancia):
+	# devuelve la lista de regresiones
+	regresiones = []
+
+	def revisar(nombre, a, b):
+		if a is None or b is None:
+			return
+		if b > a * (1 + tolerancia / 100.0):
+			regresiones.append('%s: %s -> %s' % (nombre, a, b))
+
+	for campo in ('rom', 'ram', 'pila'):
+		revisar(campo, antes.get(campo), ahora.get(campo))
+	for nombre, v in ahora['vectores'].items():
+		a = antes['vectores'].get(nombre)
+		if a:
+			revisar('%s ciclos' % nombre, a['ciclos'], v['ciclos'])
+			if a['acotado'] and not v['acotado']:
+				regresiones.append('%s: ahora sin cota' % nombre)
+	for nombre, f in ahora['funciones'].items():
+		a = antes['funciones'].get(nombre)
+		if a is None:
+			continue
+		for campo in ('ciclos', 'pila', 'ram', 'rom'):
+			revisar('%s %s' % (nombre, campo), a.get(campo), f.get(campo))
+		if a['acotado'] and not f['acotado']:
+			regresiones.append('%s: ahora sin cota' % nombre)
+	return regresiones
+
+def main():
+	parser = argparse.ArgumentParser(description='Peor caso de ciclos, pila y RAM de una compilacion CCS')
+	parser.add_argument('base', help='ruta de la compilacion sin extension (p.ej. pic18f2550ccs/main)')
+	parser.add_argument('--cotas', help='archivo de cotas de los lazos')
+	parser.add_argument('--mhz', type=float, default=48.0, help='reloj de la CPU (Fosc)')
+	parser.add_argument('--plazo', type=float, help='maximo permitido para cada interrupcion (us)')
+	parser.add_argument('--guardar', help='guarda el informe en JSON')
+	parser.add_argument('--comparar', help='informe JSON o compilacion anterior')
+	parser.add_argument('--tolerancia', type=float, default=0.0, help='aumento permitido (%%)')
+	args = parser.parse_args()
+
+	base = os.path.splitext(args.base)[0] if args.base.lower().endswith('.lst') else args.base
+	cotas = args.cotas
+	if cotas is None and os.path.exists(os.path.join(os.path.dirname(base), 'cotas.txt')):
+		cotas = os.path.join(os.path.dirname(base), 'cotas.txt')
+	informe = analizar(base, leer_cotas(cotas))
+	bien = mostrar(informe, args.mhz, args.plazo)
+
+	if args.guardar:
+		with open(args.guardar, 'w') as f:
+			json.dump(informe, f, indent=1)
+
+	if args.comparar:
+		if args.comparar.endswith('.json'):
+			antes = json.load(open(args.comparar))
+		else:
+			antes = analizar(os.path.splitext(args.comparar)[0] if args.comparar.lower().endswith('.lst')
+							 else args.comparar, leer_cotas(cotas))
+		regresiones = comparar(antes, informe, args.tolerancia)
+		print('\nComparacion con %s: %s' % (args.comparar,
+			'sin regresiones' if not regresiones else '%d regresiones' % len(regresiones)))
+		for r in regresiones:
+			print('  REGRESION %s' % r)
+		bien &= not regresiones
+
+	return 0 if bien else 1
+
+if __name__ == '__main__':
+	sys.exit(main())
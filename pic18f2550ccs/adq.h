@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////
+////                             adq.h                               ////
+////                                                                 ////
+//// Adquisicion del ADC (AN0) a frecuencia fija, en alta prioridad. ////
+////                                                                 ////
+//// El disparo no depende del software: CCP2 en modo "special event ////
+//// trigger" reinicia Timer3 y arranca la conversion cada           ////
+//// ADQ_PERIODO ticks.  #int_ad (alta prioridad) solo guarda el     ////
+//// resultado en un anillo de bloques; el USB, que es de baja       ////
+//// prioridad, nunca retrasa una muestra.                           ////
+////                                                                 ////
+//// Requiere #device HIGH_INTS=TRUE antes de incluir usb_cdc.h, asi ////
+//// el USB queda en baja prioridad y esta ISR y la de reloj.h en    ////
+//// alta.                                                           ////
+////                                                                 ////
+//// Datos compartidos entre niveles:                                ////
+////   adq_entra  - solo lo escribe la ISR (8 bits, lectura atomica) ////
+////   adq_sale   - solo lo escribe el lazo principal                ////
+////   adq_perdidos, adq_lat_min/max - 16 bits: leerlos con          ////
+////      ADQ_PAUSAR()/ADQ_SEGUIR() para no ver medio valor.  Solo   ////
+////      apagan INT_AD y devuelven ADIE como estaba, asi sirven     ////
+////      desde el lazo y desde la ISR del USB.                      ////
+//// La ISR de alta prioridad no llama a nada del USB/CDC.           ////
+////                                                                 ////
+//// Latencia: Timer3 se reinicia en el instante del disparo, asi    ////
+//// que su valor al entrar a la ISR es conversion + latencia.  Se   ////
+//// guardan el minimo y el maximo; max - min es el jitter del       ////
+//// camino de alta prioridad (ver comando S121$).  Con              ////
+//// ADC_CLOCK_DIV_64 y 4 TAD de adquisicion la conversion dura      ////
+//// 15 TAD = 20us (30 ticks); el resto de adq_lat_max es latencia.  ////
+////                                                                 ////
+//// Con ADQ_UMBRAL definido la ISR mantiene adq_sobre_umbral: pasa  ////
+//// a 1 cuando una lectura llega a ADQ_UMBRAL y vuelve a 0 al bajar ////
+//// de ADQ_UMBRAL-ADQ_HISTERESIS (ver avisos.h).                    ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef ADQ_H
+#define ADQ_H
+
+#include <reloj.h>
+
+#define ADQ_HZ          1000                  // muestras por segundo
+#define ADQ_PERIODO     (RELOJ_HZ/ADQ_HZ)     // Timer3 va a 1.5MHz, igual que Timer1
+#define ADQ_BLOQUE      8                     // muestras por bloque
+#define ADQ_BLOQUES     8                     // bloques en el anillo (potencia de 2)
+
+typedef struct {
+   unsigned int32 t;                   // ticks (reloj.h) de la primera muestra
+   unsigned int16 v[ADQ_BLOQUE];       // lecturas de 10 bits
+} adq_bloque_t;
+
+adq_bloque_t adq_anillo[ADQ_BLOQUES];
+unsigned int8 adq_entra;               // proximo bloque que llena la ISR
+unsigned int8 adq_sale;                // proximo bloque que envia el lazo
+unsigned int8 adq_n;                   // muestras del bloque en curso (solo ISR)
+unsigned int16 adq_perdidos;           // bloques descartados por anillo lleno
+unsigned int16 adq_lat_min, adq_lat_max;
+
+#ifdef ADQ_UMBRAL
+ #ifndef ADQ_HISTERESIS
+  #define ADQ_HISTERESIS  8                   // cuentas del ADC (~40mV)
+ #endif
+int1 adq_sobre_umbral;                 // solo lo escribe la ISR
+#endif
+
+#bit ADQ_ADIE = getenv("BIT:ADIE")
+
+// al principio de la funcion: declara donde guarda ADIE
+#define ADQ_PAUSAR()   int1 adq_old_adie; adq_old_adie = ADQ_ADIE; ADQ_ADIE = 0
+#define ADQ_SEGUIR()   if (adq_old_adie) ADQ_ADIE = 1
+
+#define adq_hay_bloque()   (adq_sale != adq_entra)
+#define adq_bloque()       (&adq_anillo[adq_sale])
+#define adq_liberar()      (adq_sale = (adq_sale + 1) & (ADQ_BLOQUES - 1))
+#define adq_pendientes()   ((adq_entra - adq_sale) & (ADQ_BLOQUES - 1))
+
+#int_ad HIGH
+void adq_isr(void)
+{
+   static int1 descartar;
+   unsigned int16 lat, v;
+
+   lat = get_timer3();
+   if (lat < adq_lat_min)
+      adq_lat_min = lat;
+   if (lat > adq_lat_max)
+      adq_lat_max = lat;
+
+   // con el anillo lleno se pierde el bloque entero, no muestras sueltas
+   if (adq_n == 0)
+   {
+      descartar = (((adq_entra + 1) & (ADQ_BLOQUES - 1)) == adq_sale);
+      if (descartar)
+         adq_perdidos++;
+      else
+         adq_anillo[adq_entra].t = reloj_leer() - lat;   // la conversion empezo 'lat' ticks antes
+   }
+
+   v = read_adc(ADC_READ_ONLY);
+   if (!descartar)
+      adq_anillo[adq_entra].v[adq_n] = v;
+
+  #ifdef ADQ_UMBRAL
+   if (v >= ADQ_UMBRAL)
+      adq_sobre_umbral = 1;
+   else if (v < ADQ_UMBRAL - ADQ_HISTERESIS)
+      adq_sobre_umbral = 0;
+  #endif
+
+   if (++adq_n >= ADQ_BLOQUE)
+   {
+      adq_n = 0;
+      if (!descartar)
+         adq_entra = (adq_entra + 1) & (ADQ_BLOQUES - 1);
+   }
+}
+
+void adq_init(void)
+{
+   adq_entra = 0;
+   adq_sale = 0;
+   adq_n = 0;
+   adq_perdidos = 0;
+   adq_lat_min = 0xFFFF;
+   adq_lat_max = 0;
+  #ifdef ADQ_UMBRAL
+   adq_sobre_umbral = 0;
+  #endif
+
+   setup_adc_ports(AN0);
+   setup_adc(ADC_CLOCK_DIV_64 | ADC_TAD_MUL_4);   // adquisicion automatica antes de convertir
+   set_adc_channel(0);
+
+   setup_timer_3(T3_INTERNAL | T3_DIV_BY_8 | T3_CCP2);
+   set_timer3(0);
+   CCP_2 = ADQ_PERIODO - 1;
+   setup_ccp2(CCP_COMPARE_RESET_TIMER);           // special event: reinicia Timer3 y dispara el ADC
+
+   clear_interrupt(INT_AD);
+   enable_interrupts(INT_AD);
+}
+
+// lee y reinicia la medicion de latencia (ticks de 0.667us)
+void adq_latencia(unsigned int16 *min, unsigned int16 *max)
+{
+   ADQ_PAUSAR();
+   *min = adq_lat_min;
+   *max = adq_lat_max;
+   adq_lat_min = 0xFFFF;
+   adq_lat_max = 0;
+   ADQ_SEGUIR();
+}
+
+#endif
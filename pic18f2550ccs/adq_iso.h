@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////
+////                           adq_iso.h                             ////
+////                                                                 ////
+//// Envio de los bloques de adq.h por el endpoint isocrono de       ////
+//// usb_desc_adq.h.  El host reserva el ancho de banda: un paquete  ////
+//// por trama de 1ms, sin reintentos.                               ////
+////                                                                 ////
+//// Formato del paquete (little endian):                            ////
+////   [0]  secuencia, +1 por paquete (el host detecta perdidos)     ////
+////   [1]  cantidad de bloques                                      ////
+////   por bloque: ticks(4) de la primera muestra + modo(1) + las    ////
+////               ADQ_BLOQUE lecturas codificadas (codec.h)         ////
+//// Siempre se arma un paquete, aunque sea sin bloques, asi el host ////
+//// distingue "no habia muestras" de "se perdio la trama".          ////
+////                                                                 ////
+//// adq_iso_activo indica si el host esta leyendo el endpoint.      ////
+//// Mientras no lo haga, solo se arman paquetes vacios y las        ////
+//// muestras siguen yendo por el CDC.                               ////
+////                                                                 ////
+//// adq_iso_tarea() se llama en el lazo principal; nunca espera.    ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef ADQ_ISO_H
+#define ADQ_ISO_H
+
+#include <adq.h>
+#include <codec.h>
+
+#define ADQ_ISO_BLOQUE_MAX (4+1+CODEC_EMPACADO_LARGO(ADQ_BLOQUE))   // peor caso de un bloque
+#define ADQ_ISO_VIGENCIA   (RELOJ_HZ/100)   // 10ms sin lecturas: el host ya no lee
+
+unsigned int8 adq_iso_paquete[USB_ADQ_ISO_SIZE];
+unsigned int8 adq_iso_secuencia;
+unsigned int32 adq_iso_ultimo;         // ticks del ultimo paquete leido por el host
+int1 adq_iso_armado;
+int1 adq_iso_activo;
+
+void adq_iso_tarea(void)
+{
+   unsigned int8 n, *p;
+   adq_bloque_t *b;
+
+   if (!usb_tbe(USB_ADQ_ISO_ENDPOINT))
+   {
+      // sigue esperando a que el host lo lea
+      if (adq_iso_activo && (reloj_leer() - adq_iso_ultimo) > ADQ_ISO_VIGENCIA)
+         adq_iso_activo = FALSE;
+      return;
+   }
+
+   if (adq_iso_armado)
+   {
+      adq_iso_activo = TRUE;
+      adq_iso_ultimo = reloj_leer();
+   }
+
+   p = &adq_iso_paquete[2];
+   n = 0;
+   while (adq_iso_activo && adq_hay_bloque()
+          && (p + ADQ_ISO_BLOQUE_MAX <= &adq_iso_paquete[USB_ADQ_ISO_SIZE]))
+   {
+      b = adq_bloque();
+      *p++ = make8(b->t, 0);
+      *p++ = make8(b->t, 1);
+      *p++ = make8(b->t, 2);
+      *p++ = make8(b->t, 3);
+      p += codec_bloque(b->v, ADQ_BLOQUE, p);
+      adq_liberar();
+      n++;
+   }
+
+   adq_iso_paquete[0] = adq_iso_secuencia++;
+   adq_iso_paquete[1] = n;
+   adq_iso_armado = usb_put_packet(USB_ADQ_ISO_ENDPOINT, adq_iso_paquete,
+                                   p - adq_iso_paquete, USB_DTS_DATA0);
+}
+
+void adq_iso_init(void)
+{
+   adq_iso_secuencia = 0;
+   adq_iso_armado = FALSE;
+   adq_iso_activo = FALSE;
+}
+
+#endif
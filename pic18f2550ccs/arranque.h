@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////////////
+////                           arranque.h                            ////
+////                                                                 ////
+//// Hitos del arranque, en ticks de reloj.h desde reloj_init() al   ////
+//// entrar a main():                                                ////
+////   ARRANQUE_CONEXION  - el PIC se conecto al bus (pull-up)       ////
+////   ARRANQUE_ENUMERADO - el host lo configuro                     ////
+////   ARRANQUE_LINEA     - primer Set_Line_Coding del CDC, el host  ////
+////                        abrio el puerto                          ////
+////   ARRANQUE_DATO      - primer dato de adquisicion enviado       ////
+//// Solo se guarda la primera vez: si el host se desconecta y       ////
+//// vuelve, no cambian.  Cuales ya ocurrieron lo dice               ////
+//// arranque_marcados y no el valor, porque la conexion llega en    ////
+//// el primer usb_task(), pocos ticks despues de reloj_init().      ////
+////                                                                 ////
+//// Con usb_init_cs() en lugar de usb_init() main() no espera al    ////
+//// bus: la adquisicion arranca enseguida, el anillo de adq.h       ////
+//// guarda los primeros bloques y salen al enumerar.                ////
+////                                                                 ////
+//// arranque_init()     - despues de reloj_init().                  ////
+//// arranque_tarea()    - despues de cada usb_task().               ////
+//// arranque_dato()     - al entregar un dato al host.              ////
+//// arranque_ms(hito)   - el hito en ms redondeado hacia arriba,    ////
+////                       de 1 a 65535; 0 si todavia no ocurrio.    ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef ARRANQUE_H
+#define ARRANQUE_H
+
+#include <reloj.h>
+
+#define ARRANQUE_CONEXION   0
+#define ARRANQUE_ENUMERADO  1
+#define ARRANQUE_LINEA      2
+#define ARRANQUE_DATO       3
+#define ARRANQUE_HITOS      4
+
+#define ARRANQUE_TICKS_MS   (RELOJ_HZ / 1000)
+
+unsigned int32 arranque_hitos[ARRANQUE_HITOS];
+unsigned int8 arranque_marcados;      // bit por hito ya guardado
+
+void arranque_init(void)
+{
+   unsigned int8 i;
+
+   for (i = 0; i < ARRANQUE_HITOS; i++)
+      arranque_hitos[i] = 0;
+   arranque_marcados = 0;
+}
+
+void arranque_marcar(unsigned int8 hito)
+{
+   if (!bit_test(arranque_marcados, hito))
+   {
+      arranque_hitos[hito] = reloj_leer();
+      bit_set(arranque_marcados, hito);
+   }
+}
+
+void arranque_tarea(void)
+{
+   if (usb_state != USB_STATE_DETACHED)
+      arranque_marcar(ARRANQUE_CONEXION);
+   if (usb_enumerated())
+      arranque_marcar(ARRANQUE_ENUMERADO);
+   if (usb_cdc_connected())
+      arranque_marcar(ARRANQUE_LINEA);
+}
+
+#define arranque_dato()   arranque_marcar(ARRANQUE_DATO)
+
+unsigned int16 arranque_ms(unsigned int8 hito)
+{
+   unsigned int32 ticks;
+
+   if (!bit_test(arranque_marcados, hito))
+      return(0);
+   ticks = arranque_hitos[hito];
+   if (ticks > (unsigned int32)65534 * ARRANQUE_TICKS_MS)
+      return(65535);
+   if (ticks == 0)
+      return(1);                      // ocurrio en el mismo tick que reloj_init()
+   return((ticks + ARRANQUE_TICKS_MS - 1) / ARRANQUE_TICKS_MS);
+}
+
+#endif
@@ -0,0 +1,108 @@
+/////////////////////////////////////////////////////////////////////////
+////                            avisos.h                             ////
+////                                                                 ////
+//// Avisos al host por el endpoint de interrupcion del CDC, con la  ////
+//// notificacion SERIAL_STATE (usb_cdc_serial_state()).  El driver  ////
+//// del sistema los ve como lineas de modem, asi que el PC puede    ////
+//// dormir esperando un cambio (TIOCMIWAIT en Linux, WaitCommEvent  ////
+//// en Windows) en vez de leer el puerto a cada rato (avisos.py).   ////
+////                                                                 ////
+////   DSR (bTxCarrier) - AVISO_DATOS: cambia en cada notificacion   ////
+////                      que sigue a bloques nuevos enviados, o a   ////
+////                      un cambio de RI o de bOverRun.             ////
+////   RI  (bRingSignal)- AVISO_UMBRAL: la senal esta sobre          ////
+////                      ADQ_UMBRAL (adq.h), con histeresis.        ////
+////   bOverRun         - AVISO_LLENO: un disparo cuando el anillo   ////
+////                      de adquisicion llega a AVISOS_LLENO        ////
+////                      bloques (TIOCGICOUNT lo cuenta).           ////
+////                                                                 ////
+//// DSR cambia con todo aviso porque TIOCMIWAIT (cdc_acm) solo      ////
+//// despierta con los cambios de DSR y DCD y con RI en 1: la bajada ////
+//// de RI o un bOverRun solos no despiertan al host.                ////
+////                                                                 ////
+//// DCD (bRxCarrier) queda siempre en 0: en Linux, cdc_acm cuelga   ////
+//// (hangup) el tty cuando DCD baja si no se abrio con CLOCAL, y    ////
+//// avisar datos con DCD cortaba a cualquier cliente comun.         ////
+////                                                                 ////
+//// Todo se decide en avisos_tarea(), llamada desde el lazo         ////
+//// principal con el USB enumerado.  Si el endpoint esta ocupado no ////
+//// espera: lo intenta en la vuelta siguiente.  Solo se manda algo  ////
+//// cuando cambia el estado, a lo sumo un paquete de 10 bytes por   ////
+//// cada bInterval del endpoint (1ms con usb_desc_adq.h).           ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef AVISOS_H
+#define AVISOS_H
+
+#include <adq.h>
+
+#define AVISO_DATOS     0x02           // DSR
+#define AVISO_UMBRAL    0x08           // RI
+#define AVISO_LLENO     0x40           // bOverRun
+
+#ifndef AVISOS_LLENO
+ #define AVISOS_LLENO   (ADQ_BLOQUES - 2)     // bloques pendientes para avisar
+#endif
+
+unsigned int8 avisos_nivel;            // DSR y RI tal como los tiene que ver el host
+unsigned int8 avisos_enviado;          // ultimo estado notificado
+int1 avisos_bloques;                   // hubo bloques nuevos desde la ultima notificacion
+int1 avisos_lleno;                     // ya se aviso este llenado
+
+void avisos_init(void)
+{
+   avisos_nivel = 0;
+   avisos_enviado = 0;
+   avisos_bloques = 0;
+   avisos_lleno = 0;
+}
+
+// llamar al encolar bloques para el host
+#define aviso_datos()   (avisos_bloques = 1)
+
+void avisos_tarea(void)
+{
+   unsigned int8 estado;
+   cdc_serial_state_t s;
+
+   if (avisos_bloques)
+      estado = avisos_nivel ^ AVISO_DATOS;
+   else
+      estado = avisos_nivel;
+
+  #ifdef ADQ_UMBRAL
+   if (adq_sobre_umbral)
+      estado |= AVISO_UMBRAL;
+   else
+      estado &= ~AVISO_UMBRAL;
+  #endif
+
+   // bOverRun es de un disparo: se manda en 1 una vez y en la siguiente vuelve a 0
+   if (adq_pendientes() >= AVISOS_LLENO)
+   {
+      if (!avisos_lleno)
+         estado |= AVISO_LLENO;
+   }
+   else
+      avisos_lleno = 0;
+
+   // cambio de RI o bOverRun sin bloques nuevos: DSR cambia igual para
+   // despertar al host (la vuelta a 0 de bOverRun no hace falta verla)
+   if (!avisos_bloques && estado != avisos_nivel)
+      estado ^= AVISO_DATOS;
+
+   if (estado == avisos_enviado)
+      return;
+
+   *(unsigned int16 *)&s = estado;
+   if (!usb_cdc_serial_state(s))
+      return;                          // endpoint ocupado: en la proxima vuelta
+
+   avisos_enviado = estado;
+   avisos_nivel = estado & (AVISO_DATOS | AVISO_UMBRAL);
+   avisos_bloques = 0;
+   if (estado & AVISO_LLENO)
+      avisos_lleno = 1;
+}
+
+#endif
@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////////////////
+////                          cargador.c                             ////
+////                                                                 ////
+//// Cargador residente por USB CDC para el PIC18F2550.  Ocupa       ////
+//// 0x0000-0x1FFF y atiende el USB por polling, asi los vectores    ////
+//// de interrupcion quedan libres para la aplicacion.               ////
+////                                                                 ////
+//// Se queda en el cargador si la marca de la EEPROM esta puesta    ////
+//// (la aplicacion recibio 'B') o si no hay aplicacion grabada.     ////
+//// Ver el protocolo en cargador.h y el programa del PC en          ////
+//// cargador.py.                                                    ////
+////                                                                 ////
+//// Solapamiento: usb_cdc_getc() libera el endpoint de salida en    ////
+//// cuanto se copia el ultimo byte del paquete, asi que mientras    ////
+//// se graba una fila el SIE ya esta recibiendo la siguiente.       ////
+/////////////////////////////////////////////////////////////////////////
+
+#define CARGADOR_PROPIO
+#include <main.h>
+#include <cargador.h>
+
+// el cargador no usa interrupciones: todo el USB se atiende en usb_task()
+#define USB_ISR_POLLING
+#include <usb_cdc.h>
+
+// nada del cargador puede caer en la zona de la aplicacion
+#org APP_INICIO, APP_FIN {}
+
+#define LED2 PIN_B5
+
+// las interrupciones son siempre de la aplicacion
+#int_global
+void isr_reubicar(void)
+{
+   jump_to_isr(APP_INICIO+8);
+}
+
+unsigned int8 fila[CARGADOR_FILA];      // fila recibida del PC
+unsigned int8 leida[CARGADOR_FILA];     // fila leida de la flash
+
+// CRC16-CCITT (0x1021), igual que en cargador.py
+unsigned int16 crc16(unsigned int16 crc, unsigned int8 *p, unsigned int8 n)
+{
+   unsigned int8 i;
+
+   while(n--)
+   {
+      crc ^= make16(*p++, 0);
+      for(i=0;i<8;i++)
+      {
+         if (bit_test(crc, 15))
+            crc = (crc << 1) ^ 0x1021;
+         else
+            crc <<= 1;
+      }
+   }
+   return(crc);
+}
+
+unsigned int32 leer24(void)
+{
+   unsigned int32 v;
+
+   v = usb_cdc_getc();
+   v |= (unsigned int16)usb_cdc_getc() << 8;
+   v |= (unsigned int32)usb_cdc_getc() << 16;
+   return(v);
+}
+
+unsigned int16 leer16(void)
+{
+   unsigned int8 lo;
+
+   lo = usb_cdc_getc();
+   return(make16(usb_cdc_getc(), lo));
+}
+
+void poner24(unsigned int32 v)
+{
+   usb_cdc_putc(make8(v, 0));
+   usb_cdc_putc(make8(v, 1));
+   usb_cdc_putc(make8(v, 2));
+}
+
+void poner16(unsigned int16 v)
+{
+   usb_cdc_putc(make8(v, 0));
+   usb_cdc_putc(make8(v, 1));
+}
+
+int1 app_presente(void)
+{
+   return(read_program_eeprom(APP_INICIO) != 0xFFFF);
+}
+
+// 'W': graba una fila solo si cambia y la verifica leyendola de nuevo
+void cargador_fila(void)
+{
+   unsigned int32 dir;
+   unsigned int16 crc;
+   unsigned int8 i;
+   char est;
+
+   dir = leer24();
+   for(i=0;i<CARGADOR_FILA;i++)
+      fila[i] = usb_cdc_getc();
+   crc = leer16();
+
+   if ((dir < APP_INICIO) || (dir > APP_FIN) || (dir % CARGADOR_FILA) ||
+       (crc16(0xFFFF, fila, CARGADOR_FILA) != crc))
+   {
+      est = 'E';
+      crc = 0;
+   }
+   else
+   {
+      read_program_memory(dir, leida, CARGADOR_FILA);
+      if (memcmp(fila, leida, CARGADOR_FILA) == 0)
+         est = 'S';
+      else
+      {
+         // al empezar en el limite de un bloque, tambien lo borra
+         write_program_memory(dir, fila, CARGADOR_FILA);
+         read_program_memory(dir, leida, CARGADOR_FILA);
+         est = (memcmp(fila, leida, CARGADOR_FILA) == 0) ? 'W' : 'E';
+      }
+      crc = crc16(0xFFFF, leida, CARGADOR_FILA);
+   }
+
+   usb_cdc_putc('K');
+   poner24(dir);
+   usb_cdc_putc(est);
+   poner16(crc);
+}
+
+// 'C': CRC de una region de la flash, para verificar la imagen completa
+void cargador_crc(void)
+{
+   unsigned int32 dir;
+   unsigned int16 largo, crc;
+   unsigned int8 n;
+
+   dir = leer24();
+   largo = leer16();
+   crc = 0xFFFF;
+
+   while(largo)
+   {
+      n = (largo > CARGADOR_FILA) ? CARGADOR_FILA : largo;
+      read_program_memory(dir, leida, n);
+      crc = crc16(crc, leida, n);
+      dir += n;
+      largo -= n;
+      usb_task();
+   }
+
+   usb_cdc_putc('C');
+   poner16(crc);
+}
+
+void main(void)
+{
+   if ((read_eeprom(CARGADOR_MARCA_DIR) != CARGADOR_MARCA) && app_presente())
+      goto_address(APP_INICIO);
+
+   output_high(LED2);            // indica que estamos en el cargador
+
+   usb_cdc_init();
+   usb_init_cs();
+
+   while(TRUE)
+   {
+      usb_task();
+      if (!usb_enumerated() || !usb_cdc_kbhit())
+         continue;
+
+      switch(usb_cdc_getc())
+      {
+         case 'Q':
+            usb_cdc_putc('Q');
+            usb_cdc_putc(CARGADOR_VERSION);
+            poner24(APP_INICIO);
+            poner24(APP_FIN);
+            usb_cdc_putc(CARGADOR_FILA);
+            break;
+
+         case 'W':
+            cargador_fila();
+            break;
+
+         case 'C':
+            cargador_crc();
+            break;
+
+         case 'G':
+            // la marca se borra recien aqui: si se corta la luz a mitad de
+            // la actualizacion, la placa vuelve a arrancar en el cargador
+            write_eeprom(CARGADOR_MARCA_DIR, 0xFF);
+            usb_detach();
+            delay_ms(100);
+            reset_cpu();
+            break;
+      }
+   }
+}
@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////////////////
+////                          cargador.h                             ////
+////                                                                 ////
+//// Definiciones compartidas entre el cargador residente            ////
+//// (cargador.c) y las aplicaciones que se actualizan con el.       ////
+////                                                                 ////
+//// Mapa de memoria del PIC18F2550:                                 ////
+////   0x0000 - 0x1FFF  cargador (USB CDC por polling)               ////
+////   0x2000 - 0x7FFF  aplicacion (reset en 0x2000, ISR en 0x2008)  ////
+////                                                                 ////
+//// Una aplicacion incluye este archivo despues de usb_cdc.h; asi   ////
+//// se compila desplazada y puede saltar al cargador con            ////
+//// cargador_entrar().                                              ////
+////                                                                 ////
+//// Protocolo del cargador (binario, sobre el mismo puerto CDC):    ////
+////   'Q'                       -> 'Q' ver app_ini(3) fin(3) fila   ////
+////   'W' dir(3) datos(64) crc(2) -> 'K' dir(3) est crc(2)          ////
+////        est: 'S' fila igual (no se grabo), 'W' grabada y         ////
+////             verificada, 'E' error de verificacion/direccion     ////
+////        crc: CRC16 de la fila tal como quedo en la flash         ////
+////   'C' dir(3) largo(2)       -> 'C' crc(2) de la region          ////
+////   'G'                       -> salta a la aplicacion            ////
+//// Todos los campos multibyte van en little endian.  CRC16-CCITT   ////
+//// (polinomio 0x1021, valor inicial 0xFFFF).                       ////
+////                                                                 ////
+//// La aplicacion entra al cargador al recibir el comando 'B'.      ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef CARGADOR_H
+#define CARGADOR_H
+
+#define CARGADOR_VERSION      1
+#define CARGADOR_FIN          0x1FFF   // ultima direccion del cargador
+#define APP_INICIO            0x2000   // vector de reset de la aplicacion
+#define APP_FIN               0x7FFF   // fin de la flash del 18F2550
+#define CARGADOR_FILA         64       // bloque de borrado del PIC18F2550
+
+// marca en la ultima posicion de la EEPROM: pide quedarse en el cargador
+#define CARGADOR_MARCA_DIR    0xFF
+#define CARGADOR_MARCA        0xB0
+
+#ifndef CARGADOR_PROPIO
+// la aplicacion deja libre la zona del cargador y reubica sus vectores
+#build(reset=APP_INICIO, interrupt=APP_INICIO+8)
+#org 0, CARGADOR_FIN {}
+
+// desconecta el USB para que el host vea una nueva enumeracion y
+// reinicia dentro del cargador
+void cargador_entrar(void)
+{
+   write_eeprom(CARGADOR_MARCA_DIR, CARGADOR_MARCA);
+   usb_detach();
+   delay_ms(100);
+   reset_cpu();
+}
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+/////////////////////////////////////////////////////////////////////////
+////                            codec.h                              ////
+////                                                                 ////
+//// Codificacion compacta de bloques de lecturas de 10 bits.        ////
+////                                                                 ////
+//// CODEC_EMPACADO: 4 muestras en 5 bytes.  Los 8 bits bajos de     ////
+////   cada una y un quinto byte con los 2 altos de las cuatro       ////
+////   (muestra 0 en los bits 1..0, muestra 3 en los bits 7..6).     ////
+////   Si n no es multiplo de 4 el ultimo grupo lleva las que        ////
+////   queden y su byte de altos.                                    ////
+////                                                                 ////
+//// CODEC_DELTA: diferencia con la muestra anterior (la primera     ////
+////   contra 0, asi cada bloque se decodifica solo), en zigzag      ////
+////   (0,-1,1,-2.. -> 0,1,2,3..) y con largo variable: 1 byte si    ////
+////   cabe en 7 bits, si no 2 (7 bits bajos con el bit 7 en 1 y     ////
+////   luego el resto).  Para senales lentas queda en 8 bits por     ////
+////   muestra.                                                      ////
+////                                                                 ////
+//// codec_bloque() prueba el delta y, si no entra en el tamano del  ////
+//// empacado, lo corta y empaca: nunca usa mas de 5 bytes cada 4    ////
+//// muestras.  Sin multiplicaciones ni divisiones; unos 25 ciclos   ////
+//// por muestra, se puede llamar desde una ISR.                     ////
+////                                                                 ////
+//// El decodificador del PC esta en codec.py.                       ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#define CODEC_EMPACADO  1
+#define CODEC_DELTA     2
+
+#define CODEC_EMPACADO_LARGO(n)   ((n) + ((n)+3)/4)     // bytes para n muestras
+
+unsigned int8 codec_empacar(unsigned int16 *v, unsigned int8 n, unsigned int8 *dst)
+{
+   unsigned int8 i, alto;
+
+   for (i=n>>2; i; i--)
+   {
+      *dst++ = make8(v[0], 0);
+      *dst++ = make8(v[1], 0);
+      *dst++ = make8(v[2], 0);
+      *dst++ = make8(v[3], 0);
+      alto = make8(v[3], 1) & 3;
+      alto = (alto << 2) | (make8(v[2], 1) & 3);
+      alto = (alto << 2) | (make8(v[1], 1) & 3);
+      alto = (alto << 2) | (make8(v[0], 1) & 3);
+      *dst++ = alto;
+      v += 4;
+   }
+   if (n & 3)                       // grupo final corto
+   {
+      alto = 0;
+      for (i=0; i<(n & 3); i++)
+      {
+         *dst++ = make8(v[i], 0);
+         alto |= (make8(v[i], 1) & 3) << (i << 1);
+      }
+      *dst++ = alto;
+   }
+   return(CODEC_EMPACADO_LARGO(n));
+}
+
+// devuelve los bytes escritos, o 0 si no entra en 'max'
+unsigned int8 codec_delta(unsigned int16 *v, unsigned int8 n, unsigned int8 *dst, unsigned int8 max)
+{
+   unsigned int8 i, largo;
+   unsigned int16 anterior, z;
+   signed int16 d;
+
+   anterior = 0;
+   largo = 0;
+   for (i=0; i<n; i++)
+   {
+      d = (signed int16)v[i] - (signed int16)anterior;
+      anterior = v[i];
+      z = (unsigned int16)d << 1;
+      if (d < 0)
+         z = ~z;
+      if (z < 0x80)
+      {
+         if (++largo > max)
+            return(0);
+         *dst++ = make8(z, 0);
+      }
+      else
+      {
+         largo += 2;
+         if (largo > max)
+            return(0);
+         *dst++ = make8(z, 0) | 0x80;
+         *dst++ = (unsigned int8)(z >> 7);
+      }
+   }
+   return(largo);
+}
+
+// dst[0] = modo y luego los datos; devuelve el total de bytes
+unsigned int8 codec_bloque(unsigned int16 *v, unsigned int8 n, unsigned int8 *dst)
+{
+   unsigned int8 largo;
+
+   largo = codec_delta(v, n, dst+1, CODEC_EMPACADO_LARGO(n));
+   if (largo)
+   {
+      dst[0] = CODEC_DELTA;
+      return(largo + 1);
+   }
+   dst[0] = CODEC_EMPACADO;
+   return(codec_empacar(v, n, dst+1) + 1);
+}
+
+#endif
@@ -21,6 +21,10 @@
 // failure to do this would cause some loss of data.
 //#define USB_CDC_DELAYED_FLUSH 
 #define USB_CDC_DATA_LOCAL_SIZE  128
+
+// los mensajes cortos se juntan en un paquete y salen a lo sumo 1ms despues
+// del primer byte (Timer2), sin esperar al proximo usb_task() (ver usb_cdc.h)
+#define USB_CDC_FLUSH_US  1000
  
 static void RDA_isr(void);
 
@@ -29,12 +33,20 @@ static void RDA_isr(void);
 #include <stdlib.h>
 #include <string.h>
 
+// tiempos de conexion y enumeracion, se piden con 'U' (ver arranque.h)
+#include <reloj.h>
+#include <arranque.h>
+
+// la aplicacion se graba detras del cargador USB (ver cargador.h)
+#include <cargador.h>
+
  
 // #define USB_CON_SENSE_PIN PIN_B2 //No usado cuando alimentado desde el USB
 #define LED1 PIN_B4
 #define LED2 PIN_B5
  
 int deg=0;
+unsigned int32 led_t=0;   // ultimo cambio de LED2, en ticks de reloj.h
  
 //Define la interrupcin por recepcin Serial
 static void RDA_isr(void)
@@ -48,6 +60,15 @@ static void RDA_isr(void)
         
     if(dat[0] == 'N')
       output_toggle(LED1);
+
+    if(dat[0] == 'B')       // actualizacion de firmware
+      cargador_entrar();
+
+    if(dat[0] == 'U'){      // hitos del arranque en ms
+      printf(usb_cdc_putc_fast,"U%Lu,%Lu,%Lu,%LuF",arranque_ms(ARRANQUE_CONEXION),
+             arranque_ms(ARRANQUE_ENUMERADO),arranque_ms(ARRANQUE_LINEA),arranque_ms(ARRANQUE_DATO));
+      usb_cdc_flush_tx_buffer();
+    }
       
     }
  }
@@ -59,17 +80,21 @@ void main(){
    //bit_clear(portb,4);
    //bit_clear(portb,5);
  
+   reloj_init();
+   arranque_init();
    usb_cdc_init();
-   usb_init();
+   usb_init_cs();   // no espera al bus: usb_task() conecta y enumera
    
    //enable_interrupts(INT_RDA); //Habilita Interrupcin por serial (Recepcion USB_CDC)
    //enable_interrupts(GLOBAL);  //Habilita todas las interrupciones
    
    while(true){
       usb_task();  //Verifica la comunicacin USB
-      if(usb_enumerated()) {
+      arranque_tarea();
+      // parpadeo de 1s sin delay_ms(), asi el lazo sigue atendiendo el USB
+      if(usb_enumerated() && (reloj_leer() - led_t) >= RELOJ_HZ) {
+         led_t = reloj_leer();
          output_toggle(LED2);
-         delay_ms(1000);
       }
    }
 }
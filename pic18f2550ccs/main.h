@@ -1,4 +1,5 @@
 #include <18F2550.h>
+#device HIGH_INTS=TRUE   // reloj.h en alta prioridad, USB en baja
 //#device ADC=16
 
 //#FUSES NOWDT                    //No Watch Dog Timer
@@ -1,5 +1,6 @@
 #include <18F4550.h>
 #device ADC=10
+#device HIGH_INTS=TRUE   // adquisicion en alta prioridad, USB en baja (ver adq.h)
 #fuses HSPLL, NOWDT, NOPROTECT, NODEBUG, USBDIV, PLL5, CPUDIV1, VREGEN
 #use delay(clock=48000000)
  
@@ -23,15 +24,55 @@
 // USB message in one pass, we need to increase the CDC buffer size from
 // the normal size and use the USB_CDC_DELAYED_FLUSH option.
 // failure to do this would cause some loss of data.
-#define USB_CDC_DELAYED_FLUSH
+//#define USB_CDC_DELAYED_FLUSH
 #define USB_CDC_DATA_LOCAL_SIZE  128
+
+// en lugar de USB_CDC_DELAYED_FLUSH: paquetes llenos enseguida y lo que quede
+// a lo sumo 1ms despues de su primer byte, con Timer2 (ver usb_cdc.h)
+#define USB_CDC_FLUSH_US  1000
+
+// cada paquete recibido se copia y el endpoint queda libre enseguida: el PC
+// manda el siguiente mientras se lee este (ver usb_cdc.h)
+#define USB_CDC_RX_COPY
+
+// registro de eventos del CDC y del lazo en RAM, se vuelca con S124$ (traza.h)
+#define TRAZA
  
 static void RDA_isr(void);
+
+// endpoint isocrono para las muestras, ademas del CDC (ver adq_iso.h).
+// Sin esta opcion se usan los descriptores normales de usb_desc_cdc.h.
+#define ADQ_ISO
+
+// segundo puerto COM solo para ordenes (interfaces 3 y 4, ver usb_desc_adq.h
+// y usb_cdc.h): sus respuestas no esperan detras de las muestras
+#ifdef ADQ_ISO
+#define USB_CDC_CTL
+#endif
+
+#ifdef ADQ_ISO
+#include <pic18_usb.h>
+#include <usb_desc_adq.h>
+#endif
  
 // Includes all USB code and interrupts, as well as the CDC API
 #include <usb_cdc.h>
 #include <stdlib.h>
 #include <string.h>
+
+// la aplicacion se graba detras del cargador USB (ver cargador.h)
+#include <cargador.h>
+
+// adquisicion por disparo de hardware y marca de tiempo de cada bloque
+#define ADQ_UMBRAL  512          // 2.5V: aviso de umbral (DSR) por el endpoint de interrupcion
+#include <reloj.h>
+#include <arranque.h>   // tiempos de conexion y enumeracion (S125$)
+#include <adq.h>
+#include <avisos.h>
+#include <codec.h>
+#ifdef ADQ_ISO
+#include <adq_iso.h>
+#endif
  
 #define USB_CON_SENSE_PIN PIN_B2 //No usado cuando alimentado desde el USB
 #define LED1 PIN_B4
@@ -39,18 +80,215 @@ static void RDA_isr(void);
  
  
 int deg=0;
+int1 compacto=0;   // bloques en tramas Z binarias (S122$) o en texto (S123$)
+
+// Pedidos numerados Q<ss><ccc>$: ss es un numero de secuencia (2 digitos hex
+// en minuscula) y ccc la misma orden que en S<ccc>$.  La ISR solo los encola;
+// el lazo principal los ejecuta en orden y contesta A<ss>[respuesta]F, asi el
+// PC puede tener varios en vuelo sin esperar cada ida y vuelta.  Las ordenes
+// S<ccc>$ van a la misma cola y se contestan sin A<ss>.
+#define PEDIDOS            8       // potencia de 2; caben PEDIDOS-1
+#define PEDIDO_RESPUESTA   28      // largo maximo de A<ss>U<c>,<e>,<l>,<d>F
+#define PEDIDO_LARGO       6       // ss ccc $, tras la 'Q'
+#define PEDIDO_SIN_NUMERO  0x8000  // en pedido_orden: vino como S<ccc>$
+
+typedef struct {
+   unsigned int8 b[PEDIDO_LARGO];  // bytes del pedido en curso
+   unsigned int8 n;                // 0: ninguno en curso; si no, recibidos+1
+   unsigned int8 sec;              // del ultimo pedido completo
+   int16 orden;
+} pedido_t;
+
+pedido_t pedido_cdc;               // del puerto de datos, lo usa la ISR
+unsigned int8 pedido_sec[PEDIDOS];
+int16 pedido_orden[PEDIDOS];
+unsigned int32 pedido_hora[PEDIDOS];   // reloj_leer() al llegar, para el ping
+unsigned int8 pedidos_entra=0;     // lo escribe la ISR
+unsigned int8 pedidos_sale=0;      // lo escribe el lazo principal
+
+#define pedidos_llena()  (((pedidos_entra + 1) & (PEDIDOS - 1)) == pedidos_sale)
+
+// ejecuta una orden; si tiene respuesta deja en r su letra y valor, sin la
+// 'F', y devuelve TRUE.  Solo desde el lazo principal: si la ISR tambien la
+// llamara, CCS deshabilitaria las interrupciones durante cada llamada del
+// lazo (Warning 216) y los sprintf de 32 bits demorarian a #int_ad.
+static int1 ejecutar(int16 orden, unsigned int32 hora, char *r)
+{
+   int16 lat_min,lat_max;
+
+   traza(TRAZA_ORDEN, orden-100);
+
+   if(orden==101)
+    output_toggle(LED1);
+
+   if(orden==102)
+    output_toggle(LED2);
+
+   // ping de sincronizacion: responde la hora del PIC al recibirlo
+   if(orden==120){
+    sprintf(r,"R%Lu",hora);
+    return(TRUE);
+   }
+
+   // latencia minima y maxima de la ISR de adquisicion (ticks de 0.667us)
+   if(orden==121){
+    adq_latencia(&lat_min,&lat_max);
+    sprintf(r,"L%Lu,%Lu",lat_min,lat_max);
+    return(TRUE);
+   }
+
+   // formato de los bloques por el CDC
+   if(orden==122)
+    compacto=1;
+   if(orden==123)
+    compacto=0;
+
+   // volcado del registro de eventos (tramas Y, ver traza.h)
+   if(orden==124)
+    traza_volcar();
+
+   // hitos del arranque en ms: conexion, enumeracion, Set_Line_Coding y
+   // primer dato (0 si todavia no, ver arranque.h)
+   if(orden==125){
+    sprintf(r,"U%Lu,%Lu,%Lu,%Lu",arranque_ms(ARRANQUE_CONEXION),arranque_ms(ARRANQUE_ENUMERADO),
+            arranque_ms(ARRANQUE_LINEA),arranque_ms(ARRANQUE_DATO));
+    return(TRUE);
+   }
+
+   r[0]=0;
+   return(FALSE);
+}
+
+// junta un pedido Q byte a byte (puede venir partido entre dos paquetes USB).
+// Un byte que no corresponde a su posicion corta el pedido en el acto (si es
+// otra 'Q' empieza uno nuevo), asi un pedido roto no se come lo que sigue.
+// Devuelve TRUE cuando se completa uno valido, con p->sec y p->orden.
+static int1 armar_pedido(pedido_t *p, char c)
+{
+   unsigned int8 sec,i;
+   int16 orden;
+   int1 valido;
+
+   if(p->n==0){
+      p->n=(c=='Q');
+      return(FALSE);
+   }
+   i=p->n-1;
+   if(i<2)
+      valido=(c>='0' && c<='9') || (c>='a' && c<='f');
+   else if(i<PEDIDO_LARGO-1)
+      valido=isdigit(c);
+   else
+      valido=(c=='$');
+   if(!valido){
+      p->n=(c=='Q');
+      return(FALSE);
+   }
+   p->b[i]=c;
+   if(++p->n <= PEDIDO_LARGO)
+      return(FALSE);
+   p->n=0;
+
+   sec=0;
+   for(i=0;i<2;i++){
+      c=p->b[i];
+      if(c<='9')
+         sec=sec*16+(c-'0');
+      else
+         sec=sec*16+(c-'a'+10);
+   }
+   orden=0;
+   for(i=2;i<5;i++)
+      orden=orden*10+(p->b[i]-'0');
+
+   p->sec=sec;
+   p->orden=orden;
+   return(TRUE);
+}
+
+// la ISR solo encola; si la cola esta llena se descarta y el PC lo da por
+// perdido
+static void encolar_pedido(unsigned int8 sec, int16 orden)
+{
+   if(pedidos_llena())
+      return;
+   pedido_sec[pedidos_entra]=sec;
+   pedido_orden[pedidos_entra]=orden;
+   pedido_hora[pedidos_entra]=reloj_leer();
+   pedidos_entra=(pedidos_entra+1)&(PEDIDOS-1);
+}
+
+// contesta en orden los pedidos encolados mientras haya lugar para una
+// respuesta entera.  Todo lo que sale por el puerto de datos se escribe
+// desde el lazo, asi que nada se mete en el medio de una respuesta.
+void atender_pedidos(void)
+{
+   int16 orden;
+   char r[PEDIDO_RESPUESTA];
+
+   while(pedidos_sale!=pedidos_entra && usb_cdc_putready() >= PEDIDO_RESPUESTA){
+      orden=pedido_orden[pedidos_sale];
+      if(orden & PEDIDO_SIN_NUMERO){
+         if(ejecutar(orden & ~PEDIDO_SIN_NUMERO,pedido_hora[pedidos_sale],r))
+            printf(usb_cdc_putc_fast,"%sF",r);
+      }
+      else{
+         ejecutar(orden,pedido_hora[pedidos_sale],r);
+         printf(usb_cdc_putc_fast,"A%02x%sF",pedido_sec[pedidos_sale],r);
+      }
+      pedidos_sale=(pedidos_sale+1)&(PEDIDOS-1);
+   }
+}
+
+#ifdef USB_CDC_CTL
+// Puerto de ordenes (segundo CDC, ver usb_cdc.h): acepta solo pedidos Q y
+// los contesta ahi mismo, en su propio buffer y con envio inmediato, asi la
+// respuesta no espera detras de las muestras del puerto de datos.
+pedido_t pedido_ctl;
+
+void atender_control(void)
+{
+   char r[PEDIDO_RESPUESTA];
+
+   while(usb_cdc_ctl_putready() >= PEDIDO_RESPUESTA && usb_cdc_ctl_kbhit()){
+      if(armar_pedido(&pedido_ctl,usb_cdc_ctl_getc())){
+         ejecutar(pedido_ctl.orden,reloj_leer(),r);
+         printf(usb_cdc_ctl_putc,"A%02x%sF",pedido_ctl.sec,r);
+      }
+   }
+   usb_cdc_ctl_flush();
+}
+#endif
  
 //Define la interrupción por recepción Serial
 static void RDA_isr(void)
 {  
+ traza(TRAZA_RDA, 0);
  while(usb_cdc_kbhit())
    {
     int i=0,ini=0,fin=0;
     char dat[5];
     char degC[5];
     
+    // 'B': actualizacion de firmware, aunque haya un pedido Q a medias (un
+    // pedido nunca lleva 'B', ver armar_pedido())
+    dat[0]=usb_cdc_getc();
+    if(dat[0]=='B')
+       cargador_entrar();
+
+    // pedido numerado: se arma sin esperar a que llegue el resto
+    if(pedido_cdc.n || dat[0]=='Q'){
+       if(armar_pedido(&pedido_cdc,dat[0])){
+          encolar_pedido(pedido_cdc.sec,pedido_cdc.orden);
+          continue;
+       }
+       // si el byte corto un pedido roto (y no es otra 'Q') se atiende aca abajo
+       if(pedido_cdc.n || dat[0]=='Q')
+          continue;
+    }
+
     // Almacena 5 datos leidos del USB CDC
-     for(i=0;i<5;i++){
+     for(i=1;i<5;i++){
         dat[i]=usb_cdc_getc();
        }
    
@@ -74,46 +312,112 @@ static void RDA_isr(void)
        for(i=ini;i<=fin;i++){
         degC[i-ini]=dat[i];
        }
+       degC[fin-ini+1]=0;   // atol() necesita el fin de cadena
        
         deg = atol(degC); //Convierte el String en un valor numerico
         
-        if(deg==101)
-         output_toggle(LED1);
-         
-        if(deg==102)
-         output_toggle(LED2);
+        // sin numero de secuencia: la contesta el lazo, sin A<ss>
+        encolar_pedido(0,(int16)deg | PEDIDO_SIN_NUMERO);
     }
   }
+ traza(TRAZA_RDA|TRAZA_FIN, 0);
 }
  
  
+// bloque compacto: 'Z', largo, ticks(4) y el bloque codificado (codec.h)
+void enviar_compactos(void)
+{
+   adq_bloque_t *b;
+   unsigned int8 trama[2+4+1+CODEC_EMPACADO_LARGO(ADQ_BLOQUE)];
+   unsigned int8 i,n;
+
+   while(adq_hay_bloque() && usb_cdc_putready() >= sizeof(trama)){
+      b = adq_bloque();
+      trama[0] = 'Z';
+      trama[2] = make8(b->t,0);
+      trama[3] = make8(b->t,1);
+      trama[4] = make8(b->t,2);
+      trama[5] = make8(b->t,3);
+      n = codec_bloque(b->v,ADQ_BLOQUE,&trama[6]);
+      trama[1] = 4+n;
+      // la trama sale entera: las respuestas tambien las escribe el lazo
+      // (atender_pedidos), nunca la ISR
+      for(i=0;i<6+n;i++)
+         usb_cdc_putc_fast(trama[i]);
+      adq_liberar();
+      aviso_datos();
+      arranque_dato();
+      traza(TRAZA_BLOQUE, adq_pendientes());
+   }
+}
+
+// manda los bloques listos: T<ticks>F y una trama I<voltios>F por muestra.
+// Solo toma un bloque si entra entero en el buffer de transmision, asi el
+// lazo nunca se queda esperando al PC.
+void enviar_bloques(void)
+{
+   adq_bloque_t *b;
+   int i;
+   int16 mv;
+
+   if(compacto){
+      enviar_compactos();
+      return;
+   }
+
+   while(adq_hay_bloque() && usb_cdc_putready() >= 12+6*ADQ_BLOQUE){
+      b = adq_bloque();
+      printf(usb_cdc_putc_fast,"T%LuF",b->t);
+      for(i=0;i<ADQ_BLOQUE;i++){
+         mv = (int32)b->v[i] * 5000 / 1023;
+         printf(usb_cdc_putc_fast,"I%Lu.%02LuF",mv/1000,(mv%1000)/10);
+      }
+      adq_liberar();
+      aviso_datos();
+      arranque_dato();
+      traza(TRAZA_BLOQUE, adq_pendientes());
+   }
+}
+ 
 void main(){   
-   int16 v=0;
-   float p;
-   char msg[32]; 
-   
-   setup_adc_ports(AN0);
-   setup_adc(ADC_CLOCK_INTERNAL);
-   set_adc_channel(0);
-   
    set_tris_b(0b00000100);
    bit_clear(portb,4);
    bit_clear(portb,5);
  
+   reloj_init();
+   arranque_init();
+   adq_init();
+   avisos_init();
+  #ifdef ADQ_ISO
+   adq_iso_init();
+   usb_desc_serie();   // numero de serie desde los IDs de usuario
+  #endif
    usb_cdc_init();
-   usb_init();
+   usb_init_cs();   // no espera al bus: usb_task() conecta y enumera mientras
+                    // la adquisicion ya llena el anillo, que sale al enumerar
    
    //enable_interrupts(INT_RDA); //Habilita Interrupción por serial (Recepcion USB_CDC)
    //enable_interrupts(GLOBAL);  //Habilita todas las interrupciones
    
    while(true){
+      traza_inicio();
       usb_task();  //Verifica la comunicación USB
-      if(usb_enumerated()) {
-         v = read_adc();
-         p=5.0 * v / 1023.0;
-         sprintf(msg,"I%1.2fFI%1.2fFI%1.2fF",p,p,p); 
-         printf(usb_cdc_putc,"%s",msg); 
-         delay_ms(1000);
+      traza_lenta(TRAZA_USB_TASK);
+      arranque_tarea();
+      if(usb_enumerated()){
+         traza_tarea();
+        #ifdef USB_CDC_CTL
+         atender_control();
+        #endif
+         atender_pedidos();
+        #ifdef ADQ_ISO
+         adq_iso_tarea();
+         if(adq_iso_activo)
+            arranque_dato();
+         else                  // el host lee el isocrono: no duplicar por el CDC
+        #endif
+         enviar_bloques();
+         avisos_tarea();
       }
    }
 }
\ No newline at end of file
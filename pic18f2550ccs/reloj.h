@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////
+////                            reloj.h                              ////
+////                                                                 ////
+//// Base de tiempo libre de 32 bits para marcar las muestras.       ////
+////                                                                 ////
+//// Timer1 cuenta Fosc/4 con prescaler 8: a 48MHz son 1.5MHz, un    ////
+//// tick cada 0.667us.  Su desborde (cada 43.7ms) incrementa la     ////
+//// parte alta, asi que el contador completo da la vuelta cada      ////
+//// ~47 minutos; el PC lo desenrolla (ver sincronia.py).            ////
+////                                                                 ////
+//// El desborde se atiende en alta prioridad (#device HIGH_INTS):   ////
+//// asi ninguna ISR de alta prioridad puede ver reloj_alto a medio  ////
+//// incrementar.                                                    ////
+////                                                                 ////
+//// reloj_init() - arranca el timer y su interrupcion.              ////
+//// reloj_leer() - devuelve los ticks actuales.  Se puede llamar    ////
+////      dentro de una ISR o con las interrupciones deshabilitadas. ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef RELOJ_H
+#define RELOJ_H
+
+#define RELOJ_HZ     1500000
+
+unsigned int16 reloj_alto;
+
+#int_timer1 HIGH
+void reloj_isr(void)
+{
+   reloj_alto++;
+}
+
+void reloj_init(void)
+{
+   reloj_alto = 0;
+   setup_timer_1(T1_INTERNAL | T1_DIV_BY_8);
+   set_timer1(0);
+   clear_interrupt(INT_TIMER1);
+   enable_interrupts(INT_TIMER1);
+}
+
+unsigned int32 reloj_leer(void)
+{
+   unsigned int16 alto, bajo;
+
+   do {
+      alto = reloj_alto;
+      bajo = get_timer1();
+      // desborde aun no atendido (ISR pendiente o interrupciones apagadas)
+      if (interrupt_active(INT_TIMER1) && !bit_test(bajo, 15))
+         alto++;
+   } while (alto != reloj_alto && !interrupt_active(INT_TIMER1));
+
+   return(make32(alto, bajo));
+}
+
+#endif
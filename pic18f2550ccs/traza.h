@@ -0,0 +1,171 @@
+/////////////////////////////////////////////////////////////////////////
+////                            traza.h                              ////
+////                                                                 ////
+//// Registro de eventos en RAM para ver en que se va el tiempo      ////
+//// entre usb_task(), RDA_isr y las ISR del CDC.  Cada registro     ////
+//// tiene ticks(4) de reloj.h, evento(1) y dato(1), en un anillo    ////
+//// de TRAZA_REGISTROS que pisa los mas viejos.                     ////
+////                                                                 ////
+//// Lo incluye usb_cdc.h.  Si no se define TRAZA antes de incluir   ////
+//// usb_cdc.h, traza() y las demas macros no generan codigo.        ////
+////                                                                 ////
+//// Los eventos con duracion se registran con su codigo al entrar   ////
+//// y con codigo|TRAZA_FIN al salir; los demas son instantaneos.    ////
+//// usb_task() solo se registra si tardo mas de TRAZA_LENTO ticks,  ////
+//// asi el lazo principal no llena el anillo.                       ////
+////                                                                 ////
+//// traza_volcar() congela el anillo y traza_tarea(), desde el lazo ////
+//// principal, lo manda por el CDC en tramas binarias enteras:      ////
+////   'Y' largo indice total registros...                           ////
+//// con hasta TRAZA_POR_TRAMA registros (little endian) cada una.   ////
+//// Al terminar el anillo queda vacio y se vuelve a registrar.      ////
+//// traza.py convierte las tramas al formato de Chrome              ////
+//// (chrome://tracing, Perfetto).                                   ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TRAZA_H
+#define TRAZA_H
+
+// con duracion
+#define TRAZA_CDC_RX       0x01   // ISR USB: paquete OUT del CDC (dato: largo)
+#define TRAZA_CDC_TX       0x02   // ISR USB: IN del CDC terminado (dato: bytes en espera)
+#define TRAZA_CDC_SETUP    0x03   // ISR USB: pedido de clase al CDC (dato: bRequest)
+#define TRAZA_RDA          0x04   // RDA_isr, desde la ISR USB
+#define TRAZA_PLAZO        0x05   // ISR de Timer2 del envio agrupado (dato: bytes en espera)
+#define TRAZA_USB_TASK     0x06   // usb_task() lento
+#define TRAZA_FIN          0x80
+// instantaneos
+#define TRAZA_ENVIO        0x10   // paquete entregado al SIE (dato: largo)
+#define TRAZA_LLENO        0x11   // buffer de transmision lleno: se pisa el ultimo byte
+#define TRAZA_ORDEN        0x12   // orden ejecutada (dato: orden-100)
+#define TRAZA_BLOQUE       0x13   // bloque de muestras enviado (dato: bloques pendientes)
+#define TRAZA_ENVIO_CTL    0x14   // paquete del puerto de ordenes (dato: largo)
+
+#ifdef TRAZA
+
+#include <reloj.h>
+
+#ifndef TRAZA_REGISTROS
+ #define TRAZA_REGISTROS  32      // potencia de 2; 6 bytes de RAM cada uno
+#endif
+#ifndef TRAZA_LENTO
+ #define TRAZA_LENTO      150     // ticks (100us)
+#endif
+#define TRAZA_POR_TRAMA   8
+
+typedef struct {
+   unsigned int32 t;
+   unsigned int8 e;
+   unsigned int8 d;
+} traza_t;
+
+traza_t traza_anillo[TRAZA_REGISTROS];
+unsigned int8 traza_entra;
+unsigned int16 traza_escritos;     // total: si es >= TRAZA_REGISTROS el anillo dio la vuelta
+unsigned int32 traza_t0;           // de traza_inicio()
+int1 traza_activa=TRUE;
+int1 traza_volcando=FALSE;
+unsigned int8 traza_sale;          // volcado en curso
+unsigned int8 traza_faltan;
+unsigned int8 traza_total;
+
+#byte TRAZA_INTCON = getenv("SFR:INTCON")
+
+// se expande en cada llamada, asi sirve desde el lazo y desde las ISR de
+// las dos prioridades sin reentrada.  Apaga ambas solo mientras escribe.
+#inline
+void traza_en(unsigned int32 t, unsigned int8 e, unsigned int8 d)
+{
+   unsigned int8 gie, i;
+
+   if (!traza_activa)
+      return;
+   gie = TRAZA_INTCON & 0xC0;
+   TRAZA_INTCON &= 0x3F;
+   i = traza_entra;
+   traza_entra = (i + 1) & (TRAZA_REGISTROS - 1);
+   traza_escritos++;
+   traza_anillo[i].t = t;
+   traza_anillo[i].e = e;
+   traza_anillo[i].d = d;
+   TRAZA_INTCON |= gie;
+}
+
+#define traza(e,d)       traza_en(reloj_leer(),e,d)
+#define traza_inicio()   (traza_t0 = reloj_leer())
+
+// registra desde traza_inicio() hasta ahora, si tardo mas de TRAZA_LENTO
+#inline
+void traza_lenta(unsigned int8 e)
+{
+   unsigned int32 t;
+
+   t = reloj_leer();
+   if ((t - traza_t0) > TRAZA_LENTO)
+   {
+      traza_en(traza_t0, e, 0);
+      traza_en(t, e | TRAZA_FIN, 0);
+   }
+}
+
+// congela el anillo; traza_tarea() lo manda
+void traza_volcar(void)
+{
+   if (traza_volcando)
+      return;
+   traza_activa = FALSE;
+   traza_total = (traza_escritos < TRAZA_REGISTROS) ? traza_escritos : TRAZA_REGISTROS;
+   traza_faltan = traza_total;
+   traza_sale = (traza_entra - traza_total) & (TRAZA_REGISTROS - 1);
+   traza_volcando = TRUE;
+}
+
+// manda las tramas que entren en el buffer del CDC; nunca espera.  Un
+// anillo vacio sale como una trama sin registros.
+void traza_tarea(void)
+{
+   unsigned int8 n, i, j, *p;
+   int1 old_usbie;
+
+   while (traza_volcando && (usb_cdc_putready() >= 4 + TRAZA_POR_TRAMA*sizeof(traza_t)))
+   {
+      n = traza_faltan;
+      if (n > TRAZA_POR_TRAMA)
+         n = TRAZA_POR_TRAMA;
+
+      old_usbie = USBIE;      // la trama sale entera
+      USBIE = 0;
+      usb_cdc_putc_fast('Y');
+      usb_cdc_putc_fast(2 + n*sizeof(traza_t));
+      usb_cdc_putc_fast(traza_total - traza_faltan);
+      usb_cdc_putc_fast(traza_total);
+      for (i = 0; i < n; i++)
+      {
+         p = (unsigned int8 *)&traza_anillo[traza_sale];
+         for (j = 0; j < sizeof(traza_t); j++)
+            usb_cdc_putc_fast(p[j]);
+         traza_sale = (traza_sale + 1) & (TRAZA_REGISTROS - 1);
+      }
+      traza_faltan -= n;
+      if (traza_faltan == 0)
+      {
+         traza_volcando = FALSE;
+         traza_escritos = 0;
+         traza_activa = TRUE;
+      }
+      if (old_usbie)
+         USBIE = 1;
+   }
+}
+
+#else
+
+#define traza(e,d)
+#define traza_inicio()
+#define traza_lenta(e)
+#define traza_volcar()
+#define traza_tarea()
+
+#endif
+
+#endif
@@ -118,6 +118,53 @@
 ////  It is recommended to only use USB_CDC_DELAYED_FLUSH option     ////
 ////  if you have a main loop that periodically calls usb_task().    ////
 ////                                                                 ////
+//// USB_CDC_RX_COPY copies each received packet out of the EP2      ////
+////  OUT buffer with usb_get_packet(), which hands the buffer back  ////
+////  to the SIE at once.  The host can then send the next packet    ////
+////  while usb_cdc_getc() is still reading the copy, so reception   ////
+////  is double buffered at the cost of USB_CDC_DATA_OUT_SIZE bytes  ////
+////  of RAM.  While the copy is being read a new packet waits in    ////
+////  the endpoint buffer (the SIE NAKs anything after it).  The     ////
+////  hardware ping-pong BDs (UCFG.PPB) are not used: pic18_usb.h    ////
+////  only supports USB_PING_PONG_MODE_OFF.  Transmit is not double  ////
+////  buffered: EP2 IN has one BD, refilled from the IN done ISR,    ////
+////  so bulk IN throughput is the same with or without this option. ////
+////                                                                 ////
+//// USB_CDC_FLUSH_US (PIC18 only) coalesces small writes like       ////
+////  Nagle: usb_cdc_putc() and usb_cdc_putc_fast() send at once     ////
+////  only when a full packet (USB_CDC_DATA_IN_SIZE-1 bytes) is      ////
+////  buffered.  Otherwise the first byte into an empty buffer       ////
+////  starts Timer2, and at most USB_CDC_FLUSH_US micro-seconds      ////
+////  later its interrupt sends whatever has accumulated.  While a   ////
+////  packet is in flight the IN done interrupt still sends the      ////
+////  rest as soon as the host takes it.  Unlike                     ////
+////  USB_CDC_DELAYED_FLUSH the latency does not depend on how often ////
+////  usb_task() is called, so the two options are exclusive.        ////
+////  Timer2 (#int_timer2, same priority as the USB interrupt) is    ////
+////  reserved for this; the hold time can be up to 5461us at 48MHz. ////
+////  Its ISR flushes the local buffer, so code outside the ISRs     ////
+////  that touches the buffer pauses TMR2IE as well as USBIE.        ////
+////                                                                 ////
+//// USB_CDC_CTL adds a second CDC ACM function, a command channel   ////
+////  with its own endpoints (USB_CDC_CTL_DATA_ENDPOINT) and its     ////
+////  own small buffers, so a reply never queues behind a burst in   ////
+////  usb_cdc_put_buffer.  It needs composite descriptors that       ////
+////  define USB_CDC_CTL_* (usb_desc_adq.h).  Its API is polled      ////
+////  from the main loop, never from an ISR:                         ////
+////    usb_cdc_ctl_kbhit(), usb_cdc_ctl_getc(),                     ////
+////    usb_cdc_ctl_putc(c), usb_cdc_ctl_putready(),                 ////
+////    usb_cdc_ctl_flush(), usb_cdc_ctl_connected()                 ////
+////  Flush policy: nothing is coalesced.  usb_cdc_ctl_putc() sends  ////
+////  as soon as a packet fills and usb_cdc_ctl_flush() sends the    ////
+////  rest at once; call it after each reply and on every pass of    ////
+////  the main loop, to retry while the endpoint is busy.  Class     ////
+////  requests addressed to its interfaces are answered here too     ////
+////  (line coding and control line state are kept apart).           ////
+////                                                                 ////
+//// TRAZA records ISR entry/exit, packets, flushes and buffer-full  ////
+////  events of this driver in a RAM ring (traza.h, included below). ////
+////  Without it the hooks compile to nothing.                       ////
+////                                                                 ////
 //// This driver will load all the rest of the USB code, and a set   ////
 //// of descriptors that will properly describe a CDC device for a   ////
 //// virtual COM port (usb_desc_cdc.h)                               ////
@@ -293,6 +340,15 @@ void usb_isr_tok_out_cdc_data_dne(void);
 
 void usb_cdc_flush_tx_buffer(void);
 
+#if defined(USB_CDC_CTL)
+#define usb_cdc_ctl_putready() (sizeof(usb_cdc_ctl_tx)-usb_cdc_ctl_tx_nextin)
+#define usb_cdc_ctl_connected() (usb_cdc_ctl_got_set_line_coding)
+int1 usb_cdc_ctl_kbhit(void);
+char usb_cdc_ctl_getc(void);
+void usb_cdc_ctl_putc(char c);
+void usb_cdc_ctl_flush(void);
+#endif
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // Include the CCS USB Libraries.  See the comments at the top of these
@@ -363,6 +419,24 @@ unsigned int8 usb_cdc_put_buffer[USB_CDC_DATA_LOCAL_SIZE];
 #endif
 
 #define usb_cdc_put_buffer_free()  usb_tbe(USB_CDC_DATA_IN_ENDPOINT)
+#if defined(USB_CDC_FLUSH_US)
+ #if defined(USB_CDC_DELAYED_FLUSH)
+  #error USB_CDC_FLUSH_US and USB_CDC_DELAYED_FLUSH are exclusive
+ #endif
+
+ //Timer2 counts Fosc/4/16; the period and postscaler give the hold time
+ #define USB_CDC_T2_TICKS   ((getenv("CLOCK")/64000)*USB_CDC_FLUSH_US/1000)
+ #define USB_CDC_T2_POST    ((USB_CDC_T2_TICKS+255)/256)
+ #define USB_CDC_T2_PERIOD  (USB_CDC_T2_TICKS/USB_CDC_T2_POST-1)
+ #if (USB_CDC_T2_TICKS<2) || (USB_CDC_T2_POST>16)
+  #error USB_CDC_FLUSH_US out of range for Timer2
+ #endif
+
+ #byte USB_CDC_T2CON = getenv("SFR:T2CON")
+ #bit  USB_CDC_TMR2ON = USB_CDC_T2CON.2
+ #bit  USB_CDC_TMR2IE = getenv("BIT:TMR2IE")
+#endif
+
 #if sizeof(usb_cdc_put_buffer)>=0x100
  #error This is not supported.  That is because ISR may change this 16bit value while your non-ISR code is reading this.
  typedef unsigned int16 usb_cdc_tx_t;
@@ -372,8 +446,30 @@ unsigned int8 usb_cdc_put_buffer[USB_CDC_DATA_LOCAL_SIZE];
 
 usb_cdc_tx_t usb_cdc_put_buffer_nextin;
 
+#include <traza.h>
+
+#if defined(USB_CDC_CTL)
+ #if !defined(USB_CDC_CTL_DATA_ENDPOINT)
+  #error USB_CDC_CTL needs composite descriptors with a second CDC function (usb_desc_adq.h)
+ #endif
+ #ifndef USB_CDC_CTL_LOCAL_SIZE
+  #define USB_CDC_CTL_LOCAL_SIZE  32   //a few replies; sent USB_CDC_CTL_DATA_SIZE-1 at a time
+ #endif
 
-#if defined(__PIC__)
+ unsigned int8 usb_cdc_ctl_rx[USB_CDC_CTL_DATA_SIZE];
+ unsigned int8 usb_cdc_ctl_rx_len;
+ unsigned int8 usb_cdc_ctl_rx_index;
+ unsigned int8 usb_cdc_ctl_tx[USB_CDC_CTL_LOCAL_SIZE];
+ unsigned int8 usb_cdc_ctl_tx_nextin;
+
+ //kept apart from the data channel's, nothing here depends on them
+ unsigned int8 usb_cdc_ctl_line_coding[7];
+ unsigned int8 usb_cdc_ctl_carrier;
+ int1 usb_cdc_ctl_got_set_line_coding;
+#endif
+
+
+#if defined(__PIC__) && !defined(USB_CDC_RX_COPY)
  #define usb_cdc_get_buffer_status_buffer usb_ep2_rx_buffer
 #else
  unsigned int8 usb_cdc_get_buffer_status_buffer[USB_CDC_DATA_OUT_SIZE];
@@ -387,7 +483,7 @@ struct  {
    unsigned int reserved:6;
 } usb_cdc_carrier;
 
-enum {USB_CDC_OUT_NOTHING=0, USB_CDC_OUT_COMMAND=1, USB_CDC_OUT_LINECODING=2, USB_CDC_WAIT_0LEN=3} __usb_cdc_state;
+enum {USB_CDC_OUT_NOTHING=0, USB_CDC_OUT_COMMAND=1, USB_CDC_OUT_LINECODING=2, USB_CDC_WAIT_0LEN=3, USB_CDC_OUT_CTL_LINECODING=4} __usb_cdc_state;
 
 /*
 #if defined(__PCH__)
@@ -431,6 +527,14 @@ void usb_isr_tok_out_cdc_control_dne(void) {
          usb_put_0len_0();
          break;
 
+    #if defined(USB_CDC_CTL)
+      case USB_CDC_OUT_CTL_LINECODING:
+         memcpy(usb_cdc_ctl_line_coding, usb_ep0_rx_buffer,7);
+         __usb_cdc_state=0;
+         usb_put_0len_0();
+         break;
+    #endif
+
       default:
          __usb_cdc_state=0;
          //usb_init_ep0_setup(); //REMOVED JUN/9/2009
@@ -438,8 +542,40 @@ void usb_isr_tok_out_cdc_control_dne(void) {
    }
 }
 
+#if defined(USB_CDC_CTL)
+//class requests for the command channel's interfaces
+void usb_isr_tkn_cdc_ctl(void) {
+   switch(usb_ep0_rx_buffer[1]) {
+      case 0x20:  //set_line_coding
+         __usb_cdc_state=USB_CDC_OUT_CTL_LINECODING;
+         usb_cdc_ctl_got_set_line_coding=TRUE;
+         usb_request_get_data();
+         break;
+
+      case 0x21:  //get_line_coding
+         memcpy(usb_ep0_tx_buffer, usb_cdc_ctl_line_coding, sizeof(usb_cdc_ctl_line_coding));
+         usb_request_send_response(sizeof(usb_cdc_ctl_line_coding));
+         break;
+
+      case 0x22:  //set_control_line_state
+         usb_cdc_ctl_carrier=usb_ep0_rx_buffer[2];
+         usb_put_0len_0();
+         break;
+
+      case 0x23:  //send_break
+         usb_put_0len_0();
+         break;
+
+      default:
+         usb_request_stall();
+         break;
+   }
+}
+#endif
+
 //handle IN token on 0 (setup packet)
 void usb_isr_tkn_cdc(void) {
+   traza(TRAZA_CDC_SETUP, usb_ep0_rx_buffer[1]);
    //make sure the request goes to a CDC interface
    if ((usb_ep0_rx_buffer[4] == 1) || (usb_ep0_rx_buffer[4] == 0)) {
       //printf(putc_tbe,"!%X!\r\n", usb_ep0_rx_buffer[1]);
@@ -481,10 +617,36 @@ void usb_isr_tkn_cdc(void) {
             break;
       }
    }
+  #if defined(USB_CDC_CTL)
+   else if ((usb_ep0_rx_buffer[4] == USB_CDC_CTL_COMM_INTERFACE) || (usb_ep0_rx_buffer[4] == USB_CDC_CTL_DATA_INTERFACE)) {
+      usb_isr_tkn_cdc_ctl();
+   }
+  #endif
+   traza(TRAZA_CDC_SETUP|TRAZA_FIN, usb_ep0_rx_buffer[1]);
 }
 
+#if defined(USB_CDC_RX_COPY)
+//copy the waiting packet, if any, and give the endpoint buffer back to the
+//SIE.  While the previous copy is still being read the packet stays put.
+void usb_cdc_rx_load(void)
+{
+   while (!usb_cdc_get_buffer_status.got && usb_kbhit(USB_CDC_DATA_OUT_ENDPOINT))
+   {
+      usb_cdc_get_buffer_status.index=0;
+      usb_cdc_get_buffer_status.len=usb_get_packet(USB_CDC_DATA_OUT_ENDPOINT,
+         usb_cdc_get_buffer_status_buffer,USB_CDC_DATA_OUT_SIZE);
+      if (usb_cdc_get_buffer_status.len)   //ignore 0 length packets
+         usb_cdc_get_buffer_status.got=TRUE;
+   }
+}
+#endif
+
 //handle OUT token done interrupt on endpoint 2 [buffer incoming received chars]
 void usb_isr_tok_out_cdc_data_dne(void) {
+   traza(TRAZA_CDC_RX, 0);
+#if defined(USB_CDC_RX_COPY)
+   usb_cdc_rx_load();
+#else
    usb_cdc_get_buffer_status.got=TRUE;
    usb_cdc_get_buffer_status.index=0;
 #if (defined(__PIC__) && __PIC__)
@@ -497,6 +659,8 @@ void usb_isr_tok_out_cdc_data_dne(void) {
    {
       usb_cdc_get_discard();
    }
+#endif
+   traza(TRAZA_CDC_RX|TRAZA_FIN, usb_cdc_get_buffer_status.len);
    /*
   #if defined(USB_CDC_ISR)
    else
@@ -510,7 +674,9 @@ void usb_isr_tok_out_cdc_data_dne(void) {
 //handle IN token done interrupt on endpoint 2 [transmit buffered characters]
 void usb_isr_tok_in_cdc_data_dne(void) 
 {
+   traza(TRAZA_CDC_TX, usb_cdc_put_buffer_nextin);
    usb_cdc_flush_tx_buffer();
+   traza(TRAZA_CDC_TX|TRAZA_FIN, usb_cdc_put_buffer_nextin);
 }
 
 #include <string.h>
@@ -526,6 +692,7 @@ void usb_cdc_flush_tx_buffer(void)
      #ifndef USB_CDC_DATA_LOCAL_SIZE
       if (usb_put_packet(USB_CDC_DATA_IN_ENDPOINT,usb_cdc_put_buffer,usb_cdc_put_buffer_nextin,USB_DTS_TOGGLE))
       {
+         traza(TRAZA_ENVIO, usb_cdc_put_buffer_nextin);
          usb_cdc_put_buffer_nextin = 0;
       }
      #else
@@ -534,6 +701,7 @@ void usb_cdc_flush_tx_buffer(void)
          n = USB_CDC_DATA_IN_SIZE-1;
       if (usb_put_packet(USB_CDC_DATA_IN_ENDPOINT,usb_cdc_put_buffer,n,USB_DTS_TOGGLE))
       {
+         traza(TRAZA_ENVIO, n);
          //pull the buffer back
          memmove(usb_cdc_put_buffer, &usb_cdc_put_buffer[n], usb_cdc_put_buffer_nextin-n);
          usb_cdc_put_buffer_nextin -= n;
@@ -554,6 +722,27 @@ void usb_cdc_init(void)
    usb_cdc_put_buffer_nextin = 0;
    usb_cdc_get_buffer_status.got = 0;
    __usb_cdc_state = 0;
+  #if defined(USB_CDC_CTL)
+   usb_cdc_ctl_line_coding[0] = 0x80;    //9600 8N1, like the data channel
+   usb_cdc_ctl_line_coding[1] = 0x25;
+   usb_cdc_ctl_line_coding[2] = 0;
+   usb_cdc_ctl_line_coding[3] = 0;
+   usb_cdc_ctl_line_coding[4] = 0;
+   usb_cdc_ctl_line_coding[5] = 0;
+   usb_cdc_ctl_line_coding[6] = 8;
+   usb_cdc_ctl_carrier = 0;
+   usb_cdc_ctl_got_set_line_coding = FALSE;
+   usb_cdc_ctl_rx_len = 0;
+   usb_cdc_ctl_rx_index = 0;
+   usb_cdc_ctl_tx_nextin = 0;
+  #endif
+  #if defined(USB_CDC_FLUSH_US)
+   //the timer is left configured but stopped; usb_cdc_hold_tx() starts it
+   setup_timer_2(T2_DIV_BY_16, USB_CDC_T2_PERIOD, USB_CDC_T2_POST);
+   USB_CDC_TMR2ON = 0;
+   clear_interrupt(INT_TIMER2);
+   enable_interrupts(INT_TIMER2);
+  #endif
 }
 
 ////////////////// END USB CONTROL HANDLING //////////////////////////////////
@@ -620,8 +809,19 @@ int1 usb_cdc_serial_state(cdc_serial_state_t state)
 
 void usb_cdc_get_discard(void)
 {
+  #if defined(USB_CDC_RX_COPY)
+   int1 old_usbie;
+
+   old_usbie = USBIE;
+   USBIE = 0;
+   usb_cdc_get_buffer_status.got = FALSE;
+   usb_cdc_rx_load();         //a packet may already be waiting in the endpoint
+   if (old_usbie)
+      USBIE = 1;
+  #else
    usb_cdc_get_buffer_status.got = FALSE;
    usb_flush_out(USB_CDC_DATA_OUT_ENDPOINT, USB_DTS_TOGGLE);
+  #endif
 }
 
 char usb_cdc_getc(void) 
@@ -645,8 +845,15 @@ char usb_cdc_getc(void)
    return(c);
 }
 
-#define __USB_PAUSE_ISR()  int1 old_usbie; old_usbie = USBIE; USBIE = 0
-#define __USB_RESTORE_ISR() if (old_usbie) USBIE = 1
+#if defined(USB_CDC_FLUSH_US)
+ //usb_cdc_deadline_isr() also flushes usb_cdc_put_buffer
+ #define __USB_PAUSE_ISR()  int1 old_usbie, old_tmr2ie; old_usbie = USBIE; old_tmr2ie = USB_CDC_TMR2IE; \
+      USBIE = 0; USB_CDC_TMR2IE = 0
+ #define __USB_RESTORE_ISR() if (old_tmr2ie) USB_CDC_TMR2IE = 1; if (old_usbie) USBIE = 1
+#else
+ #define __USB_PAUSE_ISR()  int1 old_usbie; old_usbie = USBIE; USBIE = 0
+ #define __USB_RESTORE_ISR() if (old_usbie) USBIE = 1
+#endif
 
 static void _usb_cdc_putc_fast_noflush(char c)
 {
@@ -661,6 +868,7 @@ static void _usb_cdc_putc_fast_noflush(char c)
 
    if (usb_cdc_put_buffer_nextin >= sizeof(usb_cdc_put_buffer)) {
       usb_cdc_put_buffer_nextin = sizeof(usb_cdc_put_buffer)-1;  //we just overflowed the buffer!
+      traza(TRAZA_LLENO, 0);
    }
    
    usb_cdc_put_buffer[usb_cdc_put_buffer_nextin++] = c;
@@ -668,6 +876,38 @@ static void _usb_cdc_putc_fast_noflush(char c)
    __USB_RESTORE_ISR();
 }
 
+#if defined(USB_CDC_FLUSH_US)
+//send a full packet now, otherwise make sure the deadline is running
+static void usb_cdc_hold_tx(void)
+{
+   __USB_PAUSE_ISR();
+
+   if (usb_cdc_put_buffer_nextin >= (USB_CDC_DATA_IN_SIZE-1))
+   {
+      usb_cdc_flush_tx_buffer();
+   }
+   else if ((usb_cdc_put_buffer_nextin != 0) && !USB_CDC_TMR2ON)
+   {
+      set_timer2(0);    //also clears the prescaler and postscaler
+      clear_interrupt(INT_TIMER2);
+      USB_CDC_TMR2ON = 1;
+   }
+
+   __USB_RESTORE_ISR();
+}
+
+//deadline of the oldest held byte.  If the endpoint is still busy nothing
+//is lost, the IN done interrupt sends the rest.
+#int_timer2
+static void usb_cdc_deadline_isr(void)
+{
+   traza(TRAZA_PLAZO, usb_cdc_put_buffer_nextin);
+   USB_CDC_TMR2ON = 0;
+   usb_cdc_flush_tx_buffer();
+   traza(TRAZA_PLAZO|TRAZA_FIN, usb_cdc_put_buffer_nextin);
+}
+#endif
+
 void usb_cdc_putc_fast(char c)
 {
    _usb_cdc_putc_fast_noflush(c);
@@ -680,7 +920,9 @@ void usb_cdc_putc_fast(char c)
    usb_task();
   #endif
   
-  #if !defined(USB_CDC_DELAYED_FLUSH)
+  #if defined(USB_CDC_FLUSH_US)
+   usb_cdc_hold_tx();
+  #elif !defined(USB_CDC_DELAYED_FLUSH)
    //if (usb_cdc_put_buffer_free()) 
    {
       //printf("FL2 %LU\r\n", (int16)usb_cdc_put_buffer_nextin);
@@ -735,7 +977,12 @@ int1 usb_cdc_putd(unsigned char *ptr, unsigned int8 len)
          break;
    }
    
-   usb_cdc_flush_tx_buffer();
+   {
+      //the ISRs flush the same buffer
+      __USB_PAUSE_ISR();
+      usb_cdc_flush_tx_buffer();
+      __USB_RESTORE_ISR();
+   }
    
    return(TRUE);
 }
@@ -749,6 +996,59 @@ int1 usb_cdc_puts(char *ptr)
    return(usb_cdc_putd(ptr, len));
 }
 
+#if defined(USB_CDC_CTL)
+////////////////// COMMAND CHANNEL (second CDC function) /////////////////////
+
+//loads the next OUT packet once the previous one has been read
+int1 usb_cdc_ctl_kbhit(void)
+{
+   if (usb_cdc_ctl_rx_index < usb_cdc_ctl_rx_len)
+      return(TRUE);
+   if (!usb_enumerated() || !usb_kbhit(USB_CDC_CTL_DATA_ENDPOINT))
+      return(FALSE);
+   usb_cdc_ctl_rx_len = usb_get_packet(USB_CDC_CTL_DATA_ENDPOINT, usb_cdc_ctl_rx, sizeof(usb_cdc_ctl_rx));
+   usb_cdc_ctl_rx_index = 0;
+   return(usb_cdc_ctl_rx_len != 0);
+}
+
+char usb_cdc_ctl_getc(void)
+{
+   while (!usb_cdc_ctl_kbhit())
+   {
+     #if defined(USB_ISR_POLLING)
+      usb_task();
+     #endif
+   }
+   return(usb_cdc_ctl_rx[usb_cdc_ctl_rx_index++]);
+}
+
+void usb_cdc_ctl_flush(void)
+{
+   unsigned int8 n;
+
+   n = usb_cdc_ctl_tx_nextin;
+   if ((n == 0) || !usb_tbe(USB_CDC_CTL_DATA_ENDPOINT))
+      return;
+   if (n > (USB_CDC_CTL_DATA_SIZE-1)) //one less than packet size, no 0 len packets
+      n = USB_CDC_CTL_DATA_SIZE-1;
+   if (usb_put_packet(USB_CDC_CTL_DATA_ENDPOINT, usb_cdc_ctl_tx, n, USB_DTS_TOGGLE))
+   {
+      traza(TRAZA_ENVIO_CTL, n);
+      memmove(usb_cdc_ctl_tx, &usb_cdc_ctl_tx[n], usb_cdc_ctl_tx_nextin-n);
+      usb_cdc_ctl_tx_nextin -= n;
+   }
+}
+
+//never waits: check usb_cdc_ctl_putready() first, a full buffer drops c
+void usb_cdc_ctl_putc(char c)
+{
+   if (usb_cdc_ctl_tx_nextin < sizeof(usb_cdc_ctl_tx))
+      usb_cdc_ctl_tx[usb_cdc_ctl_tx_nextin++] = c;
+   if (usb_cdc_ctl_tx_nextin >= (USB_CDC_CTL_DATA_SIZE-1))
+      usb_cdc_ctl_flush();
+}
+#endif
+
 #endif //__USB_CDC_HELPERS_ONLY__
 
 #include <ctype.h>
@@ -0,0 +1,538 @@
+/////////////////////////////////////////////////////////////////////////
+////                         usb_desc_adq.h                          ////
+////                                                                 ////
+//// Descriptores USB de pic18f_ejemplo.c: el puerto COM virtual de  ////
+//// usb_desc_cdc.h (interfaces 0 y 1) mas una interfaz de           ////
+//// fabricante (2) con un endpoint isocrono de entrada para las     ////
+//// muestras del ADC (ver adq_iso.h).                               ////
+////                                                                 ////
+//// La interfaz 2 tiene dos configuraciones alternativas, como      ////
+//// pide la especificacion para los endpoints isocronos:            ////
+////   alt 0 - sin endpoints, no reserva ancho de banda              ////
+////   alt 1 - EP3 IN isocrono de USB_ADQ_ISO_SIZE bytes cada 1ms    ////
+//// El host reserva el ancho de banda al elegir alt 1.              ////
+////                                                                 ////
+//// Al ser un dispositivo compuesto, el CDC va agrupado con un      ////
+//// Interface Association Descriptor (clase 0xEF/0x02/0x01) para    ////
+//// que el driver de CDC del sistema tome solo las interfaces 0-1.  ////
+////                                                                 ////
+//// Con USB_CDC_CTL se agrega un segundo CDC ACM (interfaces 3 y    ////
+//// 4, otra IAD) para las ordenes: EP4 de notificaciones y EP5 bulk ////
+//// de USB_CDC_CTL_DATA_SIZE bytes.  El sistema lo ve como otro     ////
+//// puerto COM (ttyACM1); usb_cdc.h le da buffers propios.          ////
+////                                                                 ////
+//// El numero de serie sale de los IDs de usuario del PIC           ////
+//// (0x200000-0x200003, 8 digitos hex): se graban una vez por placa ////
+//// con el programador (p.ej. la serializacion de MPLAB IPE) y no   ////
+//// los toca cargador.py al actualizar el programa. Como usb.c      ////
+//// solo lee los textos de USB_STRING_DESC[], ese arreglo va en RAM ////
+//// (90 bytes) y usb_desc_serie() lo completa antes de usb_init.    ////
+//// Con los IDs en blanco la serie es FFFFFFFF para todas y         ////
+//// gestor_placas.py las separa por la ruta del tty.                ////
+////                                                                 ////
+//// Incluir despues de pic18_usb.h y antes de usb_cdc.h.            ////
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __USB_DESCRIPTORS__
+#DEFINE __USB_DESCRIPTORS__
+
+#ifndef USB_CONFIG_PID
+   #define  USB_CONFIG_PID       0x000A
+#endif
+
+#ifndef USB_CONFIG_VID
+   #define  USB_CONFIG_VID       0x04D8
+#endif
+
+#ifndef USB_CONFIG_BUS_POWER
+   #define  USB_CONFIG_BUS_POWER 100   //100mA  (range is 0..500)
+#endif
+
+#ifndef USB_CONFIG_VERSION
+   #define  USB_CONFIG_VERSION   0x0100      //01.00  //range is 00.00 to 99.99
+#endif
+
+#ifndef USB_CDC_COMM_IN_ENDPOINT
+ #define USB_CDC_COMM_IN_ENDPOINT       1
+#endif
+
+#ifndef USB_CDC_COMM_IN_SIZE
+ #define USB_CDC_COMM_IN_SIZE   11
+#endif
+
+#ifndef USB_CDC_DATA_IN_ENDPOINT
+ #define USB_CDC_DATA_IN_ENDPOINT    2
+#endif
+
+#ifndef USB_CDC_DATA_IN_SIZE
+ #define USB_CDC_DATA_IN_SIZE   64
+#endif
+
+#ifndef USB_CDC_DATA_OUT_ENDPOINT
+ #define USB_CDC_DATA_OUT_ENDPOINT   2
+#endif
+
+#ifndef USB_CDC_DATA_OUT_SIZE
+ #define USB_CDC_DATA_OUT_SIZE   64
+#endif
+
+#ifndef USB_ADQ_ISO_ENDPOINT
+ #define USB_ADQ_ISO_ENDPOINT   3
+#endif
+
+#ifndef USB_ADQ_ISO_SIZE
+ #define USB_ADQ_ISO_SIZE       64
+#endif
+
+#define USB_ADQ_ISO_INTERFACE   2
+
+#if defined(USB_CDC_CTL)
+ #ifndef USB_CDC_CTL_COMM_ENDPOINT
+  #define USB_CDC_CTL_COMM_ENDPOINT   4
+ #endif
+
+ #ifndef USB_CDC_CTL_COMM_SIZE
+  #define USB_CDC_CTL_COMM_SIZE       8
+ #endif
+
+ #ifndef USB_CDC_CTL_DATA_ENDPOINT
+  #define USB_CDC_CTL_DATA_ENDPOINT   5
+ #endif
+
+ #ifndef USB_CDC_CTL_DATA_SIZE
+  #define USB_CDC_CTL_DATA_SIZE       32
+ #endif
+
+ #define USB_CDC_CTL_COMM_INTERFACE  3
+ #define USB_CDC_CTL_DATA_INTERFACE  4
+ #define USB_ADQ_NUM_INTERFACES      5
+#else
+ #define USB_ADQ_NUM_INTERFACES      3
+#endif
+
+//Tells the CCS PIC USB firmware to include HID handling code.
+#DEFINE USB_HID_DEVICE  FALSE
+
+//Tells the CCS PIC USB firmware to include CDC handling code.
+#DEFINE USB_CDC_DEVICE  TRUE
+
+#define USB_EP1_TX_ENABLE  USB_ENABLE_INTERRUPT   //turn on EP1 for IN interrupt transfers
+#define USB_EP1_TX_SIZE    USB_CDC_COMM_IN_SIZE
+
+#define USB_EP2_TX_ENABLE  USB_ENABLE_BULK        //turn on EP2 for IN bulk transfers
+#define USB_EP2_TX_SIZE    USB_CDC_DATA_IN_SIZE
+
+#define USB_EP2_RX_ENABLE  USB_ENABLE_BULK        //turn on EP2 for OUT bulk transfers
+#define USB_EP2_RX_SIZE    USB_CDC_DATA_OUT_SIZE
+
+#define USB_EP3_TX_ENABLE  USB_ENABLE_ISOCHRONOUS //turn on EP3 for IN isochronous transfers
+#define USB_EP3_TX_SIZE    USB_ADQ_ISO_SIZE
+
+#if defined(USB_CDC_CTL)
+ #define USB_EP4_TX_ENABLE  USB_ENABLE_INTERRUPT   //turn on EP4 for IN interrupt transfers (ordenes)
+ #define USB_EP4_TX_SIZE    USB_CDC_CTL_COMM_SIZE
+
+ #define USB_EP5_TX_ENABLE  USB_ENABLE_BULK        //turn on EP5 for IN bulk transfers (ordenes)
+ #define USB_EP5_TX_SIZE    USB_CDC_CTL_DATA_SIZE
+
+ #define USB_EP5_RX_ENABLE  USB_ENABLE_BULK        //turn on EP5 for OUT bulk transfers (ordenes)
+ #define USB_EP5_RX_SIZE    USB_CDC_CTL_DATA_SIZE
+#endif
+
+#include <usb.h>
+
+  #if defined(USB_CDC_CTL)
+   #DEFINE USB_TOTAL_CONFIG_LEN      166  //100 + IAD + CDC de ordenes(67-9)
+  #else
+   #DEFINE USB_TOTAL_CONFIG_LEN      100  //config+IAD+CDC(67-9)+iso alt0+iso alt1+endpoint
+  #endif
+
+   const char USB_CONFIG_DESC[] = {
+      //config_descriptor for config index 1
+         USB_DESC_CONFIG_LEN, //length of descriptor size          ==0
+         USB_DESC_CONFIG_TYPE, //constant CONFIGURATION (0x02)     ==1
+         USB_TOTAL_CONFIG_LEN,0, //size of all data returned for this config      ==2,3
+         USB_ADQ_NUM_INTERFACES, //number of interfaces this device supports       ==4
+         0x01, //identifier for this configuration.  (IF we had more than one configurations)      ==5
+         0x00, //index of string descriptor for this configuration      ==6
+        #if USB_CONFIG_BUS_POWER
+         0x80, //bit 6=1 if self powered, bit 5=1 if supports remote wakeup (we don't), bits 0-4 unused and bit7=1         ==7
+        #else
+         0xC0, //bit 6=1 if self powered, bit 5=1 if supports remote wakeup (we don't), bits 0-4 unused and bit7=1         ==7
+        #endif
+         USB_CONFIG_BUS_POWER/2, //maximum bus power required (maximum milliamperes/2)  (0x32 = 100mA)  ==8
+
+      //interface association descriptor (CDC = interfaces 0 and 1)
+         8, //length of descriptor    ==9
+         0x0B, //descriptor type (INTERFACE ASSOCIATION)    ==10
+         0, //first interface    ==11
+         2, //interface count    ==12
+         0x02, //function class (Comm Interface Class)    ==13
+         0x02, //function subclass (Abstract)    ==14
+         0x01, //function protocol (v.25ter)    ==15
+         0x00, //index of string descriptor for function    ==16
+
+      //interface descriptor 0 (comm class interface)
+         USB_DESC_INTERFACE_LEN, //length of descriptor      =17
+         USB_DESC_INTERFACE_TYPE, //constant INTERFACE (0x04)       =18
+         0x00, //number defining this interface (IF we had more than one interface)    ==19
+         0x00, //alternate setting     ==20
+         1, //number of endpoints   ==21
+         0x02, //class code, 02 = Comm Interface Class     ==22
+         0x02, //subclass code, 2 = Abstract     ==23
+         0x01, //protocol code, 1 = v.25ter      ==24
+         0x00, //index of string descriptor for interface      ==25
+
+      //class descriptor [functional header]
+         5, //length of descriptor    ==26
+         0x24, //dscriptor type (0x24 == )      ==27
+         0, //sub type (0=functional header) ==28
+         0x10,0x01, //      ==29,30 //cdc version
+
+      //class descriptor [acm header]
+         4, //length of descriptor    ==31
+         0x24, //dscriptor type (0x24 == )      ==32
+         2, //sub type (2=ACM)   ==33
+         2, //capabilities    ==34  //we can use 2 if we want to support SET_LINE_CODING, etc.
+
+      //class descriptor [union header]
+         5, //length of descriptor    ==35
+         0x24, //dscriptor type (0x24 == )      ==36
+         6, //sub type (6=union)    ==37
+         0, //master intf     ==38
+         1, //save intf0      ==39
+
+      //class descriptor [call mgmt header]
+         5, //length of descriptor    ==40
+         0x24, //dscriptor type (0x24 == )      ==41
+         1, //sub type (1=call mgmt)   ==42
+         0, //capabilities          ==43  //0 - Device does not handle call management itself.
+         1, //data interface        ==44  //interface number of data class interface
+
+      //endpoint descriptor
+         USB_DESC_ENDPOINT_LEN, //length of descriptor                   ==45
+         USB_DESC_ENDPOINT_TYPE, //constant ENDPOINT (0x05)          ==46
+         USB_CDC_COMM_IN_ENDPOINT | 0x80, //endpoint number and direction     ==47
+         0x03, //transfer type supported (0x03 is interrupt)         ==48
+         USB_CDC_COMM_IN_SIZE,0x00, //maximum packet size supported                  ==49,50
+         1,  //polling interval, in ms.  (1ms en full speed: avisos de avisos.h)      ==51
+
+      //interface descriptor 1 (data class interface)
+         USB_DESC_INTERFACE_LEN, //length of descriptor      =52
+         USB_DESC_INTERFACE_TYPE, //constant INTERFACE (0x04)       =53
+         0x01, //number defining this interface (IF we had more than one interface)    ==54
+         0x00, //alternate setting     ==55
+         2, //number of endpoints   ==56
+         0x0A, //class code, 0A = Data Interface Class     ==57
+         0x00, //subclass code      ==58
+         0x00, //protocol code      ==59
+         0x00, //index of string descriptor for interface      ==60
+
+      //endpoint descriptor
+         USB_DESC_ENDPOINT_LEN, //length of descriptor                   ==61
+         USB_DESC_ENDPOINT_TYPE, //constant ENDPOINT (0x05)          ==62
+         USB_CDC_DATA_OUT_ENDPOINT, //endpoint number and direction (0x02 = EP2 OUT)       ==63
+         0x02, //transfer type supported (0x02 is bulk)         ==64
+         make8(USB_CDC_DATA_OUT_SIZE,0),make8(USB_CDC_DATA_OUT_SIZE,1), //maximum packet size supported                  ==65,66
+         1,  //polling interval, in ms.   ==67
+
+      //endpoint descriptor
+         USB_DESC_ENDPOINT_LEN, //length of descriptor                   ==68
+         USB_DESC_ENDPOINT_TYPE, //constant ENDPOINT (0x05)          ==69
+         USB_CDC_DATA_IN_ENDPOINT | 0x80, //endpoint number and direction (0x82 = EP2 IN)       ==70
+         0x02, //transfer type supported (0x02 is bulk)         ==71
+         make8(USB_CDC_DATA_IN_SIZE,0),make8(USB_CDC_DATA_IN_SIZE,1), //maximum packet size supported                  ==72,73
+         1,  //polling interval, in ms.   ==74
+
+      //interface descriptor 2, alternate 0 (zero bandwidth)
+         USB_DESC_INTERFACE_LEN, //length of descriptor      =75
+         USB_DESC_INTERFACE_TYPE, //constant INTERFACE (0x04)       =76
+         USB_ADQ_ISO_INTERFACE, //number defining this interface    ==77
+         0x00, //alternate setting     ==78
+         0, //number of endpoints   ==79
+         0xFF, //class code, FF = vendor specific     ==80
+         0x00, //subclass code      ==81
+         0x00, //protocol code      ==82
+         0x04, //index of string descriptor for interface      ==83
+
+      //interface descriptor 2, alternate 1 (isochronous streaming)
+         USB_DESC_INTERFACE_LEN, //length of descriptor      =84
+         USB_DESC_INTERFACE_TYPE, //constant INTERFACE (0x04)       =85
+         USB_ADQ_ISO_INTERFACE, //number defining this interface    ==86
+         0x01, //alternate setting     ==87
+         1, //number of endpoints   ==88
+         0xFF, //class code, FF = vendor specific     ==89
+         0x00, //subclass code      ==90
+         0x00, //protocol code      ==91
+         0x04, //index of string descriptor for interface      ==92
+
+      //endpoint descriptor
+         USB_DESC_ENDPOINT_LEN, //length of descriptor                   ==93
+         USB_DESC_ENDPOINT_TYPE, //constant ENDPOINT (0x05)          ==94
+         USB_ADQ_ISO_ENDPOINT | 0x80, //endpoint number and direction (0x83 = EP3 IN)       ==95
+         0x05, //transfer type supported (0x01 is isochronous, 0x04 asynchronous)         ==96
+         make8(USB_ADQ_ISO_SIZE,0),make8(USB_ADQ_ISO_SIZE,1), //maximum packet size supported                  ==97,98
+         1,  //polling interval, in frames (every 1ms)   ==99
+
+     #if defined(USB_CDC_CTL)
+      //interface association descriptor (CDC de ordenes = interfaces 3 and 4)
+         8, //length of descriptor    ==100
+         0x0B, //descriptor type (INTERFACE ASSOCIATION)    ==101
+         USB_CDC_CTL_COMM_INTERFACE, //first interface    ==102
+         2, //interface count    ==103
+         0x02, //function class (Comm Interface Class)    ==104
+         0x02, //function subclass (Abstract)    ==105
+         0x01, //function protocol (v.25ter)    ==106
+         0x00, //index of string descriptor for function    ==107
+
+      //interface descriptor 3 (comm class interface)
+         USB_DESC_INTERFACE_LEN, //length of descriptor      =108
+         USB_DESC_INTERFACE_TYPE, //constant INTERFACE (0x04)       =109
+         USB_CDC_CTL_COMM_INTERFACE, //number defining this interface    ==110
+         0x00, //alternate setting     ==111
+         1, //number of endpoints   ==112
+         0x02, //class code, 02 = Comm Interface Class     ==113
+         0x02, //subclass code, 2 = Abstract     ==114
+         0x01, //protocol code, 1 = v.25ter      ==115
+         0x00, //index of string descriptor for interface      ==116
+
+      //class descriptor [functional header]
+         5, //length of descriptor    ==117
+         0x24, //dscriptor type (0x24 == )      ==118
+         0, //sub type (0=functional header) ==119
+         0x10,0x01, //      ==120,121 //cdc version
+
+      //class descriptor [acm header]
+         4, //length of descriptor    ==122
+         0x24, //dscriptor type (0x24 == )      ==123
+         2, //sub type (2=ACM)   ==124
+         2, //capabilities    ==125  //SET_LINE_CODING, etc.
+
+      //class descriptor [union header]
+         5, //length of descriptor    ==126
+         0x24, //dscriptor type (0x24 == )      ==127
+         6, //sub type (6=union)    ==128
+         USB_CDC_CTL_COMM_INTERFACE, //master intf     ==129
+         USB_CDC_CTL_DATA_INTERFACE, //save intf0      ==130
+
+      //class descriptor [call mgmt header]
+         5, //length of descriptor    ==131
+         0x24, //dscriptor type (0x24 == )      ==132
+         1, //sub type (1=call mgmt)   ==133
+         0, //capabilities          ==134  //0 - Device does not handle call management itself.
+         USB_CDC_CTL_DATA_INTERFACE, //data interface        ==135
+
+      //endpoint descriptor
+         USB_DESC_ENDPOINT_LEN, //length of descriptor                   ==136
+         USB_DESC_ENDPOINT_TYPE, //constant ENDPOINT (0x05)          ==137
+         USB_CDC_CTL_COMM_ENDPOINT | 0x80, //endpoint number and direction (0x84 = EP4 IN)     ==138
+         0x03, //transfer type supported (0x03 is interrupt)         ==139
+         USB_CDC_CTL_COMM_SIZE,0x00, //maximum packet size supported                  ==140,141
+         250,  //polling interval, in ms.  (no manda notificaciones)      ==142
+
+      //interface descriptor 4 (data class interface)
+         USB_DESC_INTERFACE_LEN, //length of descriptor      =143
+         USB_DESC_INTERFACE_TYPE, //constant INTERFACE (0x04)       =144
+         USB_CDC_CTL_DATA_INTERFACE, //number defining this interface    ==145
+         0x00, //alternate setting     ==146
+         2, //number of endpoints   ==147
+         0x0A, //class code, 0A = Data Interface Class     ==148
+         0x00, //subclass code      ==149
+         0x00, //protocol code      ==150
+         0x00, //index of string descriptor for interface      ==151
+
+      //endpoint descriptor
+         USB_DESC_ENDPOINT_LEN, //length of descriptor                   ==152
+         USB_DESC_ENDPOINT_TYPE, //constant ENDPOINT (0x05)          ==153
+         USB_CDC_CTL_DATA_ENDPOINT, //endpoint number and direction (0x05 = EP5 OUT)       ==154
+         0x02, //transfer type supported (0x02 is bulk)         ==155
+         make8(USB_CDC_CTL_DATA_SIZE,0),make8(USB_CDC_CTL_DATA_SIZE,1), //maximum packet size supported                  ==156,157
+         1,  //polling interval, in ms.   ==158
+
+      //endpoint descriptor
+         USB_DESC_ENDPOINT_LEN, //length of descriptor                   ==159
+         USB_DESC_ENDPOINT_TYPE, //constant ENDPOINT (0x05)          ==160
+         USB_CDC_CTL_DATA_ENDPOINT | 0x80, //endpoint number and direction (0x85 = EP5 IN)       ==161
+         0x02, //transfer type supported (0x02 is bulk)         ==162
+         make8(USB_CDC_CTL_DATA_SIZE,0),make8(USB_CDC_CTL_DATA_SIZE,1), //maximum packet size supported                  ==163,164
+         1,  //polling interval, in ms.   ==165
+     #endif
+   };
+
+   //****** BEGIN CONFIG DESCRIPTOR LOOKUP TABLES ********
+   //since we can't make pointers to constants in certain pic16s, this is an offset table to find
+   //  a specific descriptor in the above table.
+
+   //the maximum number of interfaces seen on any config
+   //for example, if config 1 has 1 interface and config 2 has 2 interfaces you must define this as 2
+   #define USB_MAX_NUM_INTERFACES   USB_ADQ_NUM_INTERFACES
+
+   //define how many interfaces there are per config.  [0] is the first config, etc.
+   const char USB_NUM_INTERFACES[USB_NUM_CONFIGURATIONS]={USB_ADQ_NUM_INTERFACES};
+
+   //define where to find class descriptors
+   //first dimension is the config number
+   //second dimension specifies which interface
+   //last dimension specifies which class in this interface to get, but most will only have 1 class per interface
+   //if a class descriptor is not valid, set the value to 0xFFFF
+   const int16 USB_CLASS_DESCRIPTORS[USB_NUM_CONFIGURATIONS][USB_MAX_NUM_INTERFACES][1]=
+   {
+   //config 1
+      //interface 0
+         //class 1
+         26,
+      //interface 1
+         //no classes for this interface
+         0xFFFF,
+      //interface 2
+         //no classes for this interface
+         0xFFFF
+     #if defined(USB_CDC_CTL)
+      //interface 3
+         //class 1
+         ,117,
+      //interface 4
+         //no classes for this interface
+         0xFFFF
+     #endif
+   };
+
+   #if (sizeof(USB_CONFIG_DESC) != USB_TOTAL_CONFIG_LEN)
+      #error USB_TOTAL_CONFIG_LEN not defined correctly
+   #endif
+
+
+//////////////////////////////////////////////////////////////////
+///
+///   start device descriptors
+///
+//////////////////////////////////////////////////////////////////
+
+   //device descriptor
+   const char USB_DEVICE_DESC[USB_DESC_DEVICE_LEN] ={
+         USB_DESC_DEVICE_LEN, //the length of this report   ==0
+         0x01, //the constant DEVICE (DEVICE 0x01)  ==1
+         0x00,0x02, //usb version in bcd (2.0, needed for IAD)  ==2,3
+         0xEF, //class code (EF = miscellaneous, functions defined by IADs) ==4
+         0x02, //subclass code ==5
+         0x01, //protocol code (interface association descriptor) ==6
+         USB_MAX_EP0_PACKET_LENGTH, //max packet size for endpoint 0. (SLOW SPEED SPECIFIES 8) ==7
+         USB_CONFIG_VID & 0xFF, ((USB_CONFIG_VID >> 8) & 0xFF), //vendor id       ==9, 10
+         USB_CONFIG_PID & 0xFF, ((USB_CONFIG_PID >> 8) & 0xFF), //product id, don't use 0xffff       ==11, 12
+         USB_CONFIG_VERSION & 0xFF, ((USB_CONFIG_VERSION >> 8) & 0xFF), //device release number  ==13,14
+         0x01, //index of string description of manufacturer. therefore we point to string_1 array (see below)  ==14
+         0x02, //index of string descriptor of the product  ==15
+         0x03, //index of string descriptor of serial number  ==16
+         USB_NUM_CONFIGURATIONS  //number of possible configurations  ==17
+   };
+
+
+//////////////////////////////////////////////////////////////////
+///
+///   start string descriptors
+///   String 0 is a special language string, and must be defined.  People in U.S.A. can leave this alone.
+///
+///   El numero de serie (string 3) identifica a cada placa en
+///   gestor_placas.py: lo escribe usb_desc_serie() desde los IDs de
+///   usuario. El producto (string 2) lleva el PIC para el que se compila.
+///
+//////////////////////////////////////////////////////////////////
+
+#ifndef USB_STRINGS_OVERWRITTEN
+#if getenv("DEVICE")=="PIC18F2550"
+   #define USB_DESC_MODELO '2'
+#elif getenv("DEVICE")=="PIC18F4550"
+   #define USB_DESC_MODELO '4'
+#else
+   #error usb_desc_adq.h: falta el nombre de producto para este PIC
+#endif
+
+#define USB_DESC_SERIE_DIR    0x200000   // IDs de usuario
+#define USB_DESC_SERIE_BYTES  4          // 8 digitos hex
+#define USB_DESC_SERIE_POS    50         // primer caracter de la string 3
+
+//the offset of the starting location of each string.
+//offset[0] is the start of string 0, offset[1] is the start of string 1, etc.
+const char USB_STRING_DESC_OFFSET[]={0,4,12,48,66};
+
+#define USB_STRING_DESC_COUNT sizeof(USB_STRING_DESC_OFFSET)
+
+// en RAM y no const: usb_desc_serie() escribe el numero de serie
+char USB_STRING_DESC[]={
+   //string 0
+         4, //length of string index
+         USB_DESC_STRING_TYPE, //descriptor type 0x03 (STRING)
+         0x09,0x04,   //Microsoft Defined for US-English
+   //string 1  - manufacturer
+         8, //length of string index
+         USB_DESC_STRING_TYPE, //descriptor type 0x03 (STRING)
+         'C',0,
+         'C',0,
+         'S',0,
+   //string 2 - product
+         36, //length of string index
+         USB_DESC_STRING_TYPE, //descriptor type 0x03 (STRING)
+         'P',0,
+         'I',0,
+         'C',0,
+         '1',0,
+         '8',0,
+         'F',0,
+         USB_DESC_MODELO,0,
+         '5',0,
+         '5',0,
+         '0',0,
+         ' ',0,
+         'U',0,
+         'S',0,
+         'B',0,
+         ' ',0,
+         'A',0,
+         'D',0,
+   //string 3 - serial number
+         18, //length of string index
+         USB_DESC_STRING_TYPE, //descriptor type 0x03 (STRING)
+         '0',0,
+         '0',0,
+         '0',0,
+         '0',0,
+         '0',0,
+         '0',0,
+         '0',0,
+         '0',0,
+   //string 4 - isochronous interface
+         24, //length of string index
+         USB_DESC_STRING_TYPE, //descriptor type 0x03 (STRING)
+         'A',0,
+         'd',0,
+         'q',0,
+         'u',0,
+         'i',0,
+         's',0,
+         'i',0,
+         'c',0,
+         'i',0,
+         'o',0,
+         'n',0
+};
+
+// Copia los IDs de usuario, en hex, a la string 3. Llamar antes de usb_init.
+void usb_desc_serie(void)
+{
+   unsigned int8 id[USB_DESC_SERIE_BYTES];
+   unsigned int8 i, d;
+
+   read_program_memory(USB_DESC_SERIE_DIR, id, USB_DESC_SERIE_BYTES);
+   for (i = 0; i < 2 * USB_DESC_SERIE_BYTES; i++)
+   {
+      d = id[i / 2];
+      if (bit_test(i, 0))
+         d &= 0x0F;
+      else
+         d >>= 4;
+      USB_STRING_DESC[USB_DESC_SERIE_POS + 2 * i] = (d < 10) ? '0' + d : 'A' + d - 10;
+   }
+}
+#endif   //USB_STRINGS_OVERWRITTEN
+
+#endif
@@ -1,44 +1,38 @@
 from tkinter import *
-import serial
 import os
+from enlace import EnlaceSerie
+from grafica import Grafica
 os.system('clear')
 
 # creando ventana de GUI
 root = Tk()				
 root.title('LED ON-OFF with Python')
-root.geometry("550x250")
+root.geometry("550x480")
 
 flag = 1		# auxiliar para el boton
 
-puerto = serial.Serial() 		# definiendo objeto para la comunicacion
-puerto.baudrate = 9600
-puerto.timeout = 200
+enlace = EnlaceSerie(baudrate=9600, saludo=None) 	# comunicacion en su propio hilo, sin saludo
 
 # -----------------------------------------------------------------------------------
 # funcion que se ejecuta para enviar mensaje al mcu al presionar el boton2
 def mensajeLed():
 
 	global flag
-	global puerto 
-
-	if puerto.is_open == 1:  # si esta conectado
-		while 1==1:
-			if flag == 1:		# encender led
-				myButton2.config(bg='green')
-				myButton2.config(text='LED ON')
-				flag = 2
-				puerto.write(b'on')				# manda msj de encender
-				break
-
-			if flag == 2:		# apagar led
-				myButton2.config(bg='red')
-				myButton2.config(text='LED OFF')
-				flag = 1
-				puerto.write(b'off')		   # manda msj de apagar
-				break
+
+	if enlace.conectado:  # si esta conectado
+		if flag == 1:		# encender led
+			myButton2.config(bg='green')
+			myButton2.config(text='LED ON')
+			flag = 2
+			enlace.escribir(b'on')				# manda msj de encender
+		else:				# apagar led
+			myButton2.config(bg='red')
+			myButton2.config(text='LED OFF')
+			flag = 1
+			enlace.escribir(b'off')		   # manda msj de apagar
 	else: # si no esta conectado
 		# abrir nueva ventana de dialogo
-		error2 = Tk()				
+		error2 = Toplevel(root)				
 		error2.title('errox02')
 		error2.geometry("250x100")
 
@@ -52,24 +46,16 @@ def mensajeLed():
 def conectar():
 
 	# si hay algo en el cuadro de texto, intento establecer conexion
-	if puerto.is_open == 0:			# si esta desconectado entro aqui
+	if not enlace.conectado:			# si esta desconectado entro aqui
 		if portCom.get() != "":
-
-			puerto.port = portCom.get()
-
-			try:
-				puerto.open()
-				myLabel2.config(text="Conectado")
-				myButton1.config(text='Desconectar')
-			except:
-				puerto.close()
-				# no se logró conectar
+			myLabel2.config(text="Conectando...")
+			enlace.conectar(portCom.get())		# se abre en segundo plano
 
 		# si la entrada de texto esta vacia	
 		if portCom.get() == "":
 
 			# abrir nueva ventana de dialogo
-			error = Tk()				
+			error = Toplevel(root)				
 			error.title('errox01')
 			error.geometry("200x100")
 
@@ -77,9 +63,32 @@ def conectar():
 			myLabel4 = Label(error,text="Inserte puerto válido")
 			myLabel4.grid(padx=10,pady=20)
 	else:					# si esta conectado entro aqui
-		puerto.close()
-		myLabel2.config(text="Desonectado")
-		myButton1.config(text='Conectar')
+		enlace.desconectar()
+
+# -------------------------------------------------------------------------------------
+# funcion que revisa periodicamente los eventos del hilo de comunicacion
+
+def revisarEnlace():
+
+	ultimo = None
+	for evento, dato in enlace.leer_eventos():
+		if evento == 'conectado':
+			myLabel2.config(text="Conectado")
+			myButton1.config(text='Desconectar')
+		elif evento == 'desconectado':
+			myLabel2.config(text="Desconectado")
+			myButton1.config(text='Conectar')
+			myLabel7.config(text='---')
+		elif evento == 'error':
+			myLabel2.config(text="Desconectado")		# no se logró conectar
+		elif evento == 'telemetria':
+			grafica.agregar(dato)
+			ultimo = dato
+
+	if ultimo is not None:				# una sola vez por tanda de muestras
+		myLabel7.config(text='%1.2f V' % ultimo)
+
+	root.after(50, revisarEnlace)
 
 # ---------------------------------------------------------------------------
 # construccion de la ventana de GUI
@@ -104,4 +113,18 @@ myLabel3.grid(row=1,column=2)
 myButton2 = Button(root, text="LED OFF",width=10,bg='red',command=mensajeLed)
 myButton2.grid(row=2,column=2)
 
+myLabel6 = Label(root,text="Lectura del dispositivo:")
+myLabel6.grid(row=3,column=2)
+
+myLabel7 = Label(root,text="---")
+myLabel7.grid(row=4,column=2)
+
+# ultimas 5000 muestras, 0 a 5 V, a lo sumo 30 cuadros por segundo
+grafica = Grafica(root, muestras=5000, fps=30, width=530, height=200)
+grafica.grid(row=5,column=0,columnspan=3,padx=10,pady=10,sticky='nsew')
+root.grid_rowconfigure(5,weight=1)
+root.grid_columnconfigure(2,weight=1)
+
+revisarEnlace()
+
 root.mainloop()
\ No newline at end of file
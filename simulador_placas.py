@@ -0,0 +1,88 @@
+import os
+import sys
+import pty
+import tty
+import time
+import math
+import re
+import selectors
+import argparse
+
+# -----------------------------------------------------------------------------------
+# Placas falsas sobre pseudo-terminales, para probar gestor_placas.py con carga.
+#
+#	python simulador_placas.py [--placas N] [--hz F]
+#
+# Cada placa envia tramas I<valor>F como pic18f_ejemplo.c, responde 'P' al
+# saludo 'P', contesta en orden los pedidos numerados Q<ss><ccc>$ (A<ss>F, o
+# A<ss>R<ticks>F para 120 y A<ss>U<hitos>F para 125) e ignora el resto.
+# Imprime la ruta del tty de cada placa, lista para pasarla al gestor:
+#
+#	python simulador_placas.py --placas 50 > ttys.txt &
+#	python gestor_placas.py --tty $(cat ttys.txt)
+
+PEDIDO = re.compile(rb'Q([0-9a-f]{2})(\d{3})\$')
+ARRANQUE = b'U1,1850,41237,41238'			# hitos en ms (arranque.h): el puerto se abrio
+											# 41s despues del reset, como suele pasar
+
+def responder(pendiente):
+	# respuestas a los pedidos completos; devuelve (respuestas, resto sin procesar)
+	respuestas = b''
+	fin = 0
+	for m in PEDIDO.finditer(pendiente):
+		if int(m.group(2)) == 120:
+			respuestas += b'A%sR%dF' % (m.group(1), int(time.monotonic() * 1500000) & 0xFFFFFFFF)
+		elif int(m.group(2)) == 125:
+			respuestas += b'A%s%sF' % (m.group(1), ARRANQUE)
+		else:
+			respuestas += b'A%sF' % m.group(1)
+		fin = m.end()
+	resto = pendiente[fin:]
+	return respuestas, resto[resto.rfind(b'Q'):] if b'Q' in resto else b''
+
+def main():
+	parser = argparse.ArgumentParser(description='Simulador de placas PIC18F2550')
+	parser.add_argument('--placas', type=int, default=40)
+	parser.add_argument('--hz', type=float, default=100.0, help='tramas por segundo por placa')
+	args = parser.parse_args()
+
+	selector = selectors.DefaultSelector()
+	maestros = []
+	for i in range(args.placas):
+		maestro, esclavo = pty.openpty()
+		tty.setraw(esclavo)
+		os.set_blocking(maestro, False)
+		selector.register(maestro, selectors.EVENT_READ, i)
+		maestros.append(maestro)
+		print(os.ttyname(esclavo))
+	sys.stdout.flush()
+
+	pendientes = [b''] * args.placas		# pedido Q partido entre dos lecturas
+	periodo = 1.0 / args.hz
+	proxima = time.monotonic()
+	while True:
+		for clave, _ in selector.select(max(0, proxima - time.monotonic())):
+			try:
+				datos = os.read(clave.fd, 1024)
+				if b'P' in datos:
+					os.write(clave.fd, b'P')
+				respuestas, pendientes[clave.data] = responder(pendientes[clave.data] + datos)
+				if respuestas:
+					os.write(clave.fd, respuestas)
+			except OSError:
+				pass
+
+		ahora = time.monotonic()
+		if ahora >= proxima:
+			for i, maestro in enumerate(maestros):
+				v = 2.5 + 2.5 * math.sin(ahora + i)
+				try:
+					os.write(maestro, b'I%1.2fF' % v)
+				except OSError:			# nadie lee: se descarta, como el PIC
+					pass
+			proxima += periodo
+			if proxima < ahora:			# nos atrasamos: no acumula tramas
+				proxima = ahora + periodo
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,70 @@
+import collections
+
+# -----------------------------------------------------------------------------------
+# Conversion de ticks del PIC (reloj.h) a hora del PC.
+#
+# Cada ping guarda tres instantes: cuando el PC lo envio, la hora del PIC al
+# recibirlo y cuando llego la respuesta. Suponiendo ida y vuelta simetricas,
+# la hora del PC en ese tick es el punto medio. Las respuestas que tardaron
+# de mas (tramas USB perdidas, buffers del tty) se descartan y con el resto se
+# ajusta una recta hora_pc = base + ticks * periodo: la ordenada da el
+# desfase y la pendiente la deriva del cristal.
+
+RELOJ_HZ = 1500000			# igual que en pic18f2550ccs/reloj.h
+VUELTA = 1 << 32			# el contador del PIC es de 32 bits
+
+class RelojDispositivo:
+
+	def __init__(self, hz=RELOJ_HZ, muestras=64):
+		self.hz = hz
+		self.pings = collections.deque(maxlen=muestras)		# (ticks, hora_pc, ida_y_vuelta)
+		self.base = None					# hora del PC en el tick 0
+		self.periodo = 1.0 / hz				# segundos del PC por tick del PIC
+		self.error = None					# dispersion del ajuste (s)
+		self._ultimo = None					# ultimo tick desenrollado
+
+	def desenrollar(self, ticks):
+		# extiende el contador de 32 bits tomando el valor mas cercano al anterior
+		if self._ultimo is None:
+			self._ultimo = ticks
+			return ticks
+		d = (ticks - self._ultimo) % VUELTA
+		if d >= VUELTA // 2:
+			d -= VUELTA
+		self._ultimo += d
+		return self._ultimo
+
+	def ping(self, enviado, ticks, recibido):
+		# registra un ping completo (horas del PC en segundos de time.monotonic)
+		self.pings.append((self.desenrollar(ticks), (enviado + recibido) / 2, recibido - enviado))
+		self._ajustar()
+
+	def _ajustar(self):
+		# se queda con la mitad de pings mas rapidos
+		rapidos = sorted(self.pings, key=lambda p: p[2])[:max(1, len(self.pings) // 2)]
+
+		if len(rapidos) < 2 or max(p[0] for p in rapidos) == min(p[0] for p in rapidos):
+			t, h, rtt = rapidos[0]
+			self.base = h - t * self.periodo
+			self.error = rtt / 2
+			return
+
+		# minimos cuadrados, centrado para no perder precision con ticks grandes
+		tm = sum(p[0] for p in rapidos) / len(rapidos)
+		hm = sum(p[1] for p in rapidos) / len(rapidos)
+		stt = sum((p[0] - tm) ** 2 for p in rapidos)
+		sth = sum((p[0] - tm) * (p[1] - hm) for p in rapidos)
+		self.periodo = sth / stt
+		self.base = hm - tm * self.periodo
+		self.error = (sum((p[1] - self.base - p[0] * self.periodo) ** 2 for p in rapidos)
+					  / len(rapidos)) ** 0.5
+
+	def deriva_ppm(self):
+		# cuanto adelanta (+) o atrasa (-) el cristal del PIC respecto a RELOJ_HZ
+		return (1 / (self.periodo * self.hz) - 1) * 1e6
+
+	def a_hora(self, ticks):
+		# hora del PC (time.monotonic) de un tick del PIC; None si aun no hay pings
+		if self.base is None:
+			return None
+		return self.base + self.desenrollar(ticks) * self.periodo
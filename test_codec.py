@@ -0,0 +1,198 @@
+import random
+import struct
+import unittest
+
+import codec
+from enlace import Tramas
+
+# -----------------------------------------------------------------------------------
+# Ida y vuelta del codec de bloques (codec.py / pic18f2550ccs/codec.h) y de las
+# tramas Z que arma enviar_compactos() en pic18f_ejemplo.c.
+#
+#	python -m unittest test_codec
+
+MAXIMO = 1023							# lectura de 10 bits
+
+def trama_z(ticks, valores):
+	# igual que enviar_compactos(): 'Z', largo, ticks(4) y el bloque codificado
+	bloque = codec.codificar(valores)
+	return b'Z' + bytes([4 + len(bloque)]) + struct.pack('<I', ticks) + bloque
+
+def zigzag_pic(d):
+	# codec_delta() en 16 bits: z = d << 1, invertido si d es negativo
+	z = (d << 1) & 0xFFFF
+	return ~z & 0xFFFF if d < 0 else z
+
+class Bordes:
+	# bloques con los casos limite, para n muestras
+	@staticmethod
+	def bloques(n):
+		return [
+			[0] * n,
+			[MAXIMO] * n,
+			[(0, MAXIMO)[i & 1] for i in range(n)],		# delta maxima en cada muestra
+			[(MAXIMO, 0)[i & 1] for i in range(n)],
+			[i * 127 % (MAXIMO + 1) for i in range(n)],
+			[512 + (-1) ** i * 64 for i in range(n)],	# justo en el limite de 1 byte
+		]
+
+class PruebaEmpacado(unittest.TestCase):
+
+	def test_ida_y_vuelta(self):
+		azar = random.Random(2550)
+		for n in range(1, 17):
+			for _ in range(50):
+				valores = [azar.randint(0, MAXIMO) for _ in range(n)]
+				datos = codec.empacar(valores)
+				self.assertEqual(len(datos), codec.largo_empacado(n))
+				self.assertEqual(codec.desempacar(datos, 0, n), (valores, len(datos)))
+
+	def test_bordes(self):
+		for n in range(1, 17):					# incluye grupos finales de 1, 2 y 3
+			for valores in Bordes.bloques(n):
+				datos = codec.empacar(valores)
+				self.assertEqual(codec.desempacar(datos, 0, n), (valores, len(datos)))
+
+	def test_disposicion(self):
+		# bajos de cada muestra y luego los altos, muestra 0 en los bits 1..0
+		self.assertEqual(codec.empacar([0x301, 0x002, 0x103, 0x204]), bytes([1, 2, 3, 4, 0b10010011]))
+		self.assertEqual(codec.empacar([0x3FF, 0x155]), bytes([0xFF, 0x55, 0b0111]))
+
+	def test_desde_el_medio(self):
+		datos = b'\xAA' * 3 + codec.empacar([5, 600, 1023, 0, 7])
+		self.assertEqual(codec.desempacar(datos, 3, 5), ([5, 600, 1023, 0, 7], len(datos)))
+
+class PruebaDelta(unittest.TestCase):
+
+	def test_ida_y_vuelta(self):
+		azar = random.Random(4550)
+		for n in range(1, 17):
+			for _ in range(50):
+				valores = [azar.randint(0, MAXIMO) for _ in range(n)]
+				datos = codec.delta(valores)
+				self.assertEqual(codec.des_delta(datos, 0, n), (valores, len(datos)))
+
+	def test_senal_lenta(self):
+		azar = random.Random(120)
+		valores = [500]
+		for _ in range(63):
+			valores.append(min(MAXIMO, max(0, valores[-1] + azar.randint(-64, 63))))
+		datos = codec.delta(valores)
+		self.assertEqual(len(datos), len(valores) + 1)	# un byte por muestra, 2 la primera
+		self.assertEqual(codec.des_delta(datos, 0, len(valores)), (valores, len(datos)))
+
+	def test_bordes(self):
+		for n in range(1, 17):
+			for valores in Bordes.bloques(n):
+				datos = codec.delta(valores)
+				self.assertEqual(codec.des_delta(datos, 0, n), (valores, len(datos)))
+
+	def test_largo_variable(self):
+		self.assertEqual(codec.delta([63]), bytes([126]))
+		self.assertEqual(codec.delta([0, 64]), bytes([0, 0x80, 1]))		# z=128, 2 bytes
+		self.assertEqual(codec.delta([64, 0]), bytes([0x80, 1, 127]))		# d=-64, z=127
+		self.assertEqual(codec.delta([MAXIMO, 0]), bytes([0xFE, 15, 0xFD, 15]))
+
+	def test_zigzag_como_el_pic(self):
+		for d in range(-MAXIMO, MAXIMO + 1):
+			datos = codec.delta([MAXIMO if d < 0 else 0, (MAXIMO if d < 0 else 0) + d])
+			z = zigzag_pic(d)
+			esperado = bytes([z]) if z < 0x80 else bytes([(z & 0x7F) | 0x80, z >> 7])
+			self.assertTrue(datos.endswith(esperado), d)
+
+	def test_maximo(self):
+		valores = [(0, MAXIMO)[i & 1] for i in range(8)]
+		self.assertIsNone(codec.delta(valores, codec.largo_empacado(8)))
+		self.assertEqual(len(codec.delta([1] * 8, 8)), 8)
+		self.assertIsNone(codec.delta([1] * 9, 8))
+
+class PruebaBloque(unittest.TestCase):
+
+	def test_ida_y_vuelta(self):
+		azar = random.Random(2024)
+		for n in range(1, 17):
+			for amplitud in (1, 64, 300, MAXIMO):
+				for _ in range(30):
+					base = azar.randint(0, MAXIMO - amplitud)
+					valores = [base + azar.randint(0, amplitud) for _ in range(n)]
+					datos = codec.codificar(valores)
+					self.assertLessEqual(len(datos), 1 + codec.largo_empacado(n))
+					self.assertEqual(codec.decodificar(datos, 0, n), (valores, len(datos)))
+
+	def test_modo(self):
+		self.assertEqual(codec.codificar([512] * 8)[0], codec.DELTA)
+		self.assertEqual(codec.codificar([(0, MAXIMO)[i & 1] for i in range(8)])[0], codec.EMPACADO)
+		for n in range(1, 17):
+			for valores in Bordes.bloques(n):
+				datos = codec.codificar(valores)
+				self.assertLessEqual(len(datos), 1 + codec.largo_empacado(n))
+				self.assertEqual(codec.decodificar(datos, 0, n), (valores, len(datos)))
+
+	def test_modo_desconocido(self):
+		with self.assertRaises(ValueError):
+			codec.decodificar(bytes([3]) + bytes(10), 0, 8)
+
+	def test_con_marca(self):
+		valores = [1, 2, 3, 4, 1000, 1001, 1002, 1003]
+		datos = struct.pack('<I', 0xDEADBEEF) + codec.codificar(valores)
+		self.assertEqual(codec.bloque_con_marca(datos, 0, 8), (0xDEADBEEF, valores, len(datos)))
+
+class PruebaTramaZ(unittest.TestCase):
+
+	def setUp(self):
+		self.azar = random.Random(31)
+
+	def bloque(self, amplitud=MAXIMO):
+		return [self.azar.randint(0, amplitud) for _ in range(codec.BLOQUE)]
+
+	def test_trama(self):
+		for amplitud in (0, 20, MAXIMO):
+			valores = self.bloque(amplitud)
+			self.assertEqual(Tramas().alimentar(trama_z(123456, valores)), [('Z', (123456, valores))])
+
+	def test_bordes(self):
+		for valores in Bordes.bloques(codec.BLOQUE):
+			self.assertEqual(Tramas().alimentar(trama_z(0xFFFFFFFF, valores)),
+							 [('Z', (0xFFFFFFFF, valores))])
+
+	def test_byte_a_byte(self):
+		# los paquetes USB pueden cortar la trama en cualquier byte
+		tramas = Tramas()
+		esperado, recibido = [], []
+		for i in range(20):
+			valores = self.bloque((0, 30, MAXIMO)[i % 3])
+			esperado.append(('Z', (i, valores)))
+			for b in trama_z(i, valores):
+				recibido += tramas.alimentar(bytes([b]))
+		self.assertEqual(recibido, esperado)
+
+	def test_entre_tramas_de_texto(self):
+		valores = self.bloque()
+		datos = b'T99F' + trama_z(7, valores) + b'I2.5F' + trama_z(8, valores) + b'A03F'
+		self.assertEqual(Tramas().alimentar(datos),
+						 [('T', 99), ('Z', (7, valores)), ('I', 2.5), ('Z', (8, valores)), ('A', (3, None, None))])
+
+	def test_largo_invalido(self):
+		# un largo imposible descarta la trama; las siguientes se leen bien
+		valores = self.bloque()
+		for largo in (0, 4, 6 + 2 * codec.BLOQUE):
+			datos = b'Z' + bytes([largo]) + b'R5F' + trama_z(1, valores)
+			tramas = Tramas().alimentar(datos)
+			self.assertEqual(tramas[-1], ('Z', (1, valores)), largo)
+
+	def test_largo_que_no_coincide(self):
+		# el bloque se decodifica pero no ocupa todo el largo: se descarta
+		valores = [512] * codec.BLOQUE
+		trama = bytearray(trama_z(1, valores))
+		trama[1] += 1
+		trama.append(0)
+		self.assertEqual(Tramas().alimentar(bytes(trama) + trama_z(2, valores)), [('Z', (2, valores))])
+
+	def test_modo_invalido(self):
+		valores = self.bloque()
+		trama = bytearray(trama_z(1, valores))
+		trama[6] = 7							# byte de modo
+		self.assertEqual(Tramas().alimentar(bytes(trama) + trama_z(2, valores)), [('Z', (2, valores))])
+
+if __name__ == '__main__':
+	unittest.main()
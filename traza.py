@@ -0,0 +1,103 @@
+import sys
+import json
+import time
+
+from enlace import EnlaceSerie
+
+# -----------------------------------------------------------------------------------
+# Volcado del registro de eventos de la placa (pic18f2550ccs/traza.h) al formato
+# de Chrome, para ver la linea de tiempo en chrome://tracing o ui.perfetto.dev.
+#
+#	python traza.py PUERTO [salida.json]
+#
+# Pide el volcado con S124$ y espera las tramas Y. Cada evento con duracion
+# tiene un registro al entrar y otro al salir (codigo | FIN); se dibujan como
+# barras, una fila por contexto (ISR USB, ISR de Timer2, lazo principal). Los
+# instantaneos (paquetes enviados, buffer lleno, ordenes, bloques) van en su
+# propia fila. El anillo se vacia despues de cada volcado: el siguiente solo
+# trae lo ocurrido desde este.
+
+HZ = 1500000						# RELOJ_HZ de pic18f2550ccs/reloj.h
+FIN = 0x80
+
+# codigo -> (nombre, fila)
+EVENTOS = {
+	0x01: ('CDC rx', 1),
+	0x02: ('CDC tx', 1),
+	0x03: ('CDC setup', 1),
+	0x04: ('RDA_isr', 1),
+	0x05: ('plazo Timer2', 2),
+	0x06: ('usb_task', 0),
+	0x10: ('envio', 3),
+	0x11: ('buffer lleno', 3),
+	0x12: ('orden', 3),
+	0x13: ('bloque', 3),
+	0x14: ('envio ordenes', 3),
+}
+FILAS = {0: 'lazo principal', 1: 'ISR USB', 2: 'ISR Timer2', 3: 'eventos'}
+
+def a_chrome(registros, hz=HZ):
+	# registros: [(ticks, evento, dato)] del mas viejo al mas nuevo
+	eventos = [{'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': fila, 'args': {'name': nombre}}
+			   for fila, nombre in FILAS.items()]
+	abiertos = {}							# fila -> eventos con duracion sin cerrar
+	base = None
+	anterior = 0
+	vueltas = 0
+	for ticks, codigo, dato in registros:
+		if base is None:
+			base = anterior = ticks
+		if ticks < anterior and anterior - ticks > 1 << 31:
+			vueltas += 1					# el reloj de 32 bits dio la vuelta
+		anterior = ticks
+		us = (ticks + (vueltas << 32) - base) * 1e6 / hz
+
+		nombre, fila = EVENTOS.get(codigo & ~FIN, ('evento %02X' % codigo, 3))
+		evento = {'name': nombre, 'pid': 1, 'tid': fila, 'ts': us, 'args': {'dato': dato}}
+		if codigo & ~FIN >= 0x10:
+			evento.update(ph='i', s='t')
+		elif codigo & FIN:
+			if not abiertos.get(fila):
+				continue					# entro antes del registro mas viejo
+			abiertos[fila] -= 1
+			evento['ph'] = 'E'
+		else:
+			abiertos[fila] = abiertos.get(fila, 0) + 1
+			evento['ph'] = 'B'
+		eventos.append(evento)
+	return {'traceEvents': eventos, 'displayTimeUnit': 'ms'}
+
+# -----------------------------------------------------------------------------------
+
+def main():
+	if len(sys.argv) < 2:
+		print('uso: python traza.py PUERTO [salida.json]')
+		return 1
+	salida = sys.argv[2] if len(sys.argv) > 2 else 'traza.json'
+
+	enlace = EnlaceSerie(saludo=None)
+	enlace.conectar(sys.argv[1])
+	limite = time.monotonic() + 5
+	registros = None
+	while registros is None and time.monotonic() < limite:
+		for evento, dato in enlace.leer_eventos():
+			if evento == 'conectado':
+				enlace.escribir(b'S124$')
+			elif evento == 'error':
+				print('no se pudo abrir %s' % sys.argv[1])
+				return 1
+			elif evento == 'traza':
+				registros = dato
+		time.sleep(0.01)
+	enlace.desconectar()
+
+	if registros is None:
+		print('la placa no mando el volcado (TRAZA definido en pic18f_ejemplo.c?)')
+		return 1
+	with open(salida, 'w') as f:
+		json.dump(a_chrome(registros), f)
+	print('%d registros -> %s' % (len(registros), salida))
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -1,19 +1,16 @@
 from tkinter import *				# LIBRERIA PARA GUI
 from tkinter.font import Font
-import serial                       # LIBRERIA PARA PUERTO SERIAL
 import os
 
-import serial.tools.list_ports
+from enlace import EnlaceSerie		# PUERTO SERIAL ATENDIDO EN UN HILO APARTE
 
-# definiendo objeto para la comunicacion
-puerto = serial.Serial() 			# define el objeto puerto serial		
-puerto.baudrate = 115200			# tasa de baud 115200
-puerto.timeout = 5					# time out 15s
+# definiendo objeto para la comunicacion: toda la E/S corre en su propio hilo
+enlace = EnlaceSerie(baudrate=115200)	# tasa de baud 115200, saludo 'P'
 
 # creando ventana de GUI
 root = Tk()				
 root.title('LED ON-OFF with Python')
-root.geometry("400x350")
+root.geometry("400x400")
 root.configure(background="LightSteelBlue3")		
 
 flag = 1		# auxiliar para el boton
@@ -22,24 +19,20 @@ flag = 1		# auxiliar para el boton
 # funcion que se ejecuta para enviar mensaje al mcu al presionar el boton2
 def mensajeLed():
 
-	global flag, puerto
-
-	if puerto.is_open == 1:  # si esta conectado
-		while 1==1:
-			if flag == 1:		# encender led
-				myButton2.config(bg='green',text='LED ON')		# cambia msj de boton a ON
-				flag = 2
-				puerto.write(b'N')		   # manda msj de apagar
-				break
-
-			if flag == 2:		# apagar led
-				myButton2.config(bg='red',text='LED OFF')		# cambia msj de boton a OFF
-				flag = 1
-				puerto.write(b'F')		   # manda msj de apagar	   
-				break
+	global flag
+
+	if enlace.conectado:  # si esta conectado
+		if flag == 1:		# encender led
+			myButton2.config(bg='green',text='LED ON')		# cambia msj de boton a ON
+			flag = 2
+			enlace.escribir(b'N')		   # manda msj de encender
+		else:				# apagar led
+			myButton2.config(bg='red',text='LED OFF')		# cambia msj de boton a OFF
+			flag = 1
+			enlace.escribir(b'F')		   # manda msj de apagar
 	else: # si no esta conectado
 		# abrir nueva ventana de dialogo
-		error2 = Tk()				
+		error2 = Toplevel(root)				
 		error2.title('errox02')
 		error2.geometry("250x100")
 
@@ -52,72 +45,41 @@ def mensajeLed():
 
 def conectar():
 
-	#print ("ENTRO EN CONECTAR")	    # DEBUG
-
-	if (puerto.is_open == 0):		# si el puerto esta desconectado... intenta conectar
-
-		c = 1				# variable auxiliar para emitir mensaje de error en conexion
-
-		#print ("PUERTO DESCONECTADO")		# DEBUG
-
-		ports = list(serial.tools.list_ports.comports())	# lista de puertos disponibles
-
-		for p in ports:				# intenta conectar con cada puerto
-
-			puerto.port = str(p.device)			# identifica el puerto en cuestion
-
-			#print (p.device)					# DEBUG
-			#print(puerto)						# DEBUG
-
-			if (puerto.port != ""):
-
-				#print ("Conectando...")			# DEBUG
-				#print(puerto.is_open)			# DEBUG
-
-				try:
-					puerto.open()				# abre puerto
-
-					#print(puerto.is_open)		# DEBUG
-					
-					puerto.write(b'P')		   # manda msj para conectar	
-
-					r = puerto.read()		   # lee el puerto
-					r = r.decode("utf-8")	   # cambia de byte a string
-
-					#print(r)					# DEBUG
-
-					if (r == 'P'):					# si recibe una 'P'
-						myLabel2.config(text='Conectado')		# conecto
-						myButton1.config(text='Desconectar')		# cambia msj de boton a desconectar
-
-						#print ("CONECTADO")								# DEBUG
-						c = 0
-						break									# no evalua mas puertos
-					else:
-						#print ("RECIBI OTRA COSA")				# DEBUG
-
-						puerto.close()							# cierro puerto
-						myLabel2.config(text='Desconectado')	# estado de conexion desconectado
-				except:				# si hay problemas abriendo el puerto
-					c = 1
-		if ( c == 1):
+	if not enlace.conectado:		# si el puerto esta desconectado... intenta conectar
+		myLabel2.config(text='Conectando...')
+		myButton1.config(state=DISABLED)		# hasta que el hilo responda
+		enlace.conectar()			# prueba cada puerto en segundo plano
+	else:							# si el puerto esta conectado... desconecta
+		enlace.desconectar()
 
-			#print("Conexion fallo")
-			puerto.close()		# no se logró conectar
+# -------------------------------------------------------------------------------------
+# funcion que revisa periodicamente los eventos del hilo de comunicacion
+
+def revisarEnlace():
+
+	for evento, dato in enlace.leer_eventos():
+		if evento == 'conectado':
+			myLabel2.config(text='Conectado')			# conecto
+			myButton1.config(text='Desconectar',state=NORMAL)
+		elif evento == 'desconectado':
+			myLabel2.config(text='Desconectado')
+			myButton1.config(text='Conectar',state=NORMAL)
+			myLabel7.config(text='---')
+		elif evento == 'error':
+			myLabel2.config(text='Desconectado')
+			myButton1.config(text='Conectar',state=NORMAL)
 
 			# abrir nueva ventana de dialogo: MENSAJE DE ERROR
-			error = Tk()				
-			error.title('errox04')
+			error = Toplevel(root)				
+			error.title(dato)
 			error.geometry("200x100")
 
 			myLabel4 = Label(error,text="Error en conexión")
 			myLabel4.pack(padx=10,pady=30)
-	else:							# si el puerto esta conectado... desconecta
+		elif evento == 'telemetria':
+			myLabel7.config(text='%1.2f V' % dato)		# ultima lectura del ADC
 
-		puerto.close()				# cierra puerto
-		myLabel2.config(text='Desconectado')		
-		myButton1.config(text='Conectar')
-		#print("No se pudo conectar")			# DEBUG
+	root.after(50, revisarEnlace)
 
 # ---------------------------------------------------------------------------
 # construccion de la ventana de GUI
@@ -137,4 +99,12 @@ myLabel2.pack(padx=10,pady=10)
 myButton1 = Button(root, text="Conectar",command=conectar,width=12)
 myButton1.pack(padx=10,pady=10)
 
+myLabel6 = Label(root,text="Lectura del dispositivo:", bg="LightSteelBlue3")
+myLabel6.pack(padx=10,pady=5)
+
+myLabel7 = Label(root,text="---", bg="LightSteelBlue3")
+myLabel7.pack(padx=10,pady=5)
+
+revisarEnlace()
+
 root.mainloop()
\ No newline at end of file